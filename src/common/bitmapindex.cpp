@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <iostream>
+
+#include "bitmapindex.hpp"
+
+constexpr std::size_t BitmapIndex::wordBits;
+
+inline std::size_t andCountImpl(const BitmapIndex::word_t* a, const BitmapIndex::word_t* b, BitmapIndex::word_t* out, std::size_t n) {
+	std::size_t count = 0;
+
+	if (out) {
+		for (std::size_t i = 0; i < n; ++i) {
+			out[i] = a[i] & b[i];
+			count += static_cast<std::size_t>(__builtin_popcountll(out[i]));
+		}
+	} else {
+		for (std::size_t i = 0; i < n; ++i) {
+			count += static_cast<std::size_t>(__builtin_popcountll(a[i] & b[i]));
+		}
+	}
+
+	return count;
+}
+
+std::size_t andCountGeneric(const BitmapIndex::word_t* a, const BitmapIndex::word_t* b, BitmapIndex::word_t* out, std::size_t n) {
+	return andCountImpl(a, b, out, n);
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+// the default target has no popcount instruction, the builtin would become a (much slower) bit trick
+__attribute__((target("popcnt")))
+std::size_t andCountPopcnt(const BitmapIndex::word_t* a, const BitmapIndex::word_t* b, BitmapIndex::word_t* out, std::size_t n) {
+	return andCountImpl(a, b, out, n);
+}
+
+BitmapIndex::kernel_t selectKernel() {
+	return __builtin_cpu_supports("popcnt") ? andCountPopcnt : andCountGeneric;
+}
+#else
+BitmapIndex::kernel_t selectKernel() {
+	return andCountGeneric;
+}
+#endif
+
+BitmapIndex::BitmapIndex(const std::vector<discretedim_t>& data, const std::vector<std::size_t>& _binCounts, std::size_t _maxCells) :
+	nWords((data.at(0)->getSize() + wordBits - 1) / wordBits),
+	maxCells(_maxCells),
+	binCounts(_binCounts),
+	andCount(selectKernel()),
+	offsets(),
+	bitmaps(),
+	bitmapCounts() {
+	std::cout << "Build bitmap index: " << std::flush;
+
+	std::size_t total = 0;
+	for (std::size_t dim = 0; dim < data.size(); ++dim) {
+		offsets.push_back(total);
+		total += binCounts[dim];
+	}
+	bitmaps.assign(total * nWords, 0);
+	bitmapCounts.assign(total, 0);
+
+	for (std::size_t dim = 0; dim < data.size(); ++dim) {
+		std::size_t row = 0;
+		for (std::size_t segment = 0; segment < data[dim]->getSegmentCount(); ++segment) {
+			std::size_t size = data[dim]->getSegmentFillSize(segment);
+			discretedimObj_t::segment_t* segmentPtr = data[dim]->getSegment(segment);
+
+			for (std::size_t i = 0; i < size; ++i, ++row) {
+				std::size_t bitmap = offsets[dim] + (*segmentPtr)[i];
+				bitmaps[bitmap * nWords + row / wordBits] |= static_cast<word_t>(1) << (row % wordBits);
+				++bitmapCounts[bitmap];
+			}
+		}
+
+		// report progress
+		if ((dim + 1) % 1000 == 0) {
+			std::cout << (dim + 1) << std::flush;
+		} else if ((dim + 1) % 100 == 0) {
+			std::cout << "." << std::flush;
+		}
+	}
+
+	std::cout << "done (" << (bitmaps.size() * sizeof(word_t) >> 20) << "MB)" << std::endl;
+}
+
+bool BitmapIndex::calcCounts(const subspace_t& subspace, std::vector<std::size_t>& counts) const {
+	std::vector<std::size_t> dims(subspace.begin(), subspace.end());
+	if (dims.empty()) {
+		return false;
+	}
+
+	std::size_t cells = 1;
+	for (auto dim : dims) {
+		cells *= std::max(static_cast<std::size_t>(1), binCounts.at(dim));
+		if (cells > maxCells) {
+			return false;
+		}
+	}
+
+	// one intermediate bitmap per inner level
+	std::vector<word_t> buffers((dims.size() - 1) * nWords);
+	counts.clear();
+	countCells(dims, 0, nullptr, buffers, counts);
+
+	return true;
+}
+
+void BitmapIndex::countCells(const std::vector<std::size_t>& dims, std::size_t depth, const word_t* prefix, std::vector<word_t>& buffers, std::vector<std::size_t>& counts) const {
+	std::size_t dim = dims[depth];
+	bool last = (depth + 1 == dims.size());
+	word_t* buffer = last ? nullptr : buffers.data() + depth * nWords;
+
+	for (std::size_t bin = 0; bin < binCounts[dim]; ++bin) {
+		const word_t* bitmap = getBitmap(dim, bin);
+
+		// first level needs no AND, cell = bitmap
+		std::size_t count;
+		const word_t* cell;
+		if (prefix) {
+			count = andCount(prefix, bitmap, buffer, nWords);
+			cell = buffer;
+		} else {
+			count = bitmapCounts[offsets[dim] + bin];
+			cell = bitmap;
+		}
+
+		// empty cells have no non-empty subcells
+		if (count == 0) {
+			continue;
+		}
+
+		if (last) {
+			counts.push_back(count);
+		} else {
+			countCells(dims, depth + 1, cell, buffers, counts);
+		}
+	}
+}
+
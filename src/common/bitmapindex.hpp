@@ -0,0 +1,47 @@
+#ifndef BITMAPINDEX_HPP
+#define BITMAPINDEX_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "sys.hpp"
+
+// One bitmap (bit i = row i has this value) for every (dimension, bin) pair. Cell counts of small subspaces
+// can then be calculated with AND + popcount over the bitmaps instead of scanning the discrete values.
+class BitmapIndex {
+	public:
+		typedef std::uint64_t word_t;
+
+		// popcount(a & b) over n words, also stores a & b if out is not null
+		typedef std::size_t (*kernel_t)(const word_t* a, const word_t* b, word_t* out, std::size_t n);
+
+		BitmapIndex(const std::vector<discretedim_t>& data, const std::vector<std::size_t>& binCounts, std::size_t maxCells);
+
+		// Integer count of every non-empty cell of subspace. Returns false (and leaves counts untouched) if the
+		// subspace has more than maxCells cells, the caller has to use another method then.
+		bool calcCounts(const subspace_t& subspace, std::vector<std::size_t>& counts) const;
+
+	private:
+		static constexpr std::size_t wordBits = 64;
+
+		std::size_t nWords;
+		std::size_t maxCells;
+		std::vector<std::size_t> binCounts;
+		kernel_t andCount;
+
+		// first bitmap of every dimension (in bitmaps)
+		std::vector<std::size_t> offsets;
+		std::vector<word_t> bitmaps;
+
+		// number of rows per bitmap
+		std::vector<std::size_t> bitmapCounts;
+
+		const word_t* getBitmap(std::size_t dim, std::size_t bin) const {
+			return bitmaps.data() + (offsets[dim] + bin) * nWords;
+		}
+
+		void countCells(const std::vector<std::size_t>& dims, std::size_t depth, const word_t* prefix, std::vector<word_t>& buffers, std::vector<std::size_t>& counts) const;
+};
+
+#endif
+
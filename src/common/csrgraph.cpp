@@ -0,0 +1,60 @@
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+#include "csrgraph.hpp"
+
+namespace gc = greycore;
+
+CSRGraph::CSRGraph() :
+	offsets(1, 0),
+	neighbors() {}
+
+CSRGraph::CSRGraph(std::vector<std::size_t>&& _offsets, std::vector<std::size_t>&& _neighbors) :
+	offsets(std::move(_offsets)),
+	neighbors(std::move(_neighbors)) {
+	assert(!offsets.empty());
+	assert(offsets.back() == neighbors.size());
+}
+
+CSRGraph::CSRGraph(std::shared_ptr<gc::Graph> graph) :
+	offsets(1, 0),
+	neighbors() {
+	offsets.reserve(graph->getSize() + 1);
+
+	for (std::size_t v = 0; v < graph->getSize(); ++v) {
+		auto tmp = graph->get(v);
+		auto first = neighbors.insert(neighbors.end(), tmp.begin(), tmp.end());
+
+		// sort and remove duplicates
+		std::sort(first, neighbors.end());
+		neighbors.erase(std::unique(first, neighbors.end()), neighbors.end());
+
+		offsets.push_back(neighbors.size());
+	}
+}
+
+void CSRGraph::store(std::shared_ptr<gc::Database> db, const std::string& name) const {
+	auto dimOffsets = db->createDim<std::size_t>(name + ".offsets");
+	for (auto x : offsets) {
+		dimOffsets->add(x);
+	}
+
+	auto dimNeighbors = db->createDim<std::size_t>(name + ".neighbors");
+	for (auto x : neighbors) {
+		dimNeighbors->add(x);
+	}
+}
+
+CSRBuilder::CSRBuilder() :
+	offsets(1, 0),
+	neighbors() {}
+
+CSRGraph CSRBuilder::finish() {
+	std::vector<std::size_t> o(1, 0);
+	std::vector<std::size_t> n;
+	std::swap(o, offsets);
+	std::swap(n, neighbors);
+	return CSRGraph(std::move(o), std::move(n));
+}
+
@@ -0,0 +1,97 @@
+#ifndef CSRGRAPH_HPP
+#define CSRGRAPH_HPP
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "greycore/database.hpp"
+#include "greycore/wrapper/graph.hpp"
+
+// immutable graph in compressed sparse row format, neighbors of every vertex are sorted
+class CSRGraph {
+	public:
+		// view to the neighbors of one vertex, no allocation
+		class Neighbors {
+			public:
+				typedef const std::size_t* const_iterator;
+				typedef const_iterator iterator;
+				typedef std::size_t value_type;
+
+				Neighbors(const_iterator _first, const_iterator _last) :
+					first(_first),
+					last(_last) {}
+
+				const_iterator begin() const {
+					return first;
+				}
+
+				const_iterator end() const {
+					return last;
+				}
+
+				std::size_t size() const {
+					return static_cast<std::size_t>(last - first);
+				}
+
+				bool empty() const {
+					return first == last;
+				}
+
+				std::size_t operator[](std::size_t i) const {
+					return first[i];
+				}
+
+			private:
+				const_iterator first;
+				const_iterator last;
+		};
+
+		CSRGraph();
+		CSRGraph(std::vector<std::size_t>&& offsets, std::vector<std::size_t>&& neighbors);
+		explicit CSRGraph(std::shared_ptr<greycore::Graph> graph);
+
+		void store(std::shared_ptr<greycore::Database> db, const std::string& name) const;
+
+		std::size_t getSize() const {
+			return offsets.size() - 1;
+		}
+
+		std::size_t getEdgeCount() const {
+			return neighbors.size();
+		}
+
+		Neighbors get(std::size_t v) const {
+			return Neighbors(neighbors.data() + offsets[v], neighbors.data() + offsets[v + 1]);
+		}
+
+	private:
+		std::vector<std::size_t> offsets;
+		std::vector<std::size_t> neighbors;
+};
+
+// helper to create a CSRGraph row by row
+class CSRBuilder {
+	public:
+		CSRBuilder();
+
+		template <typename Iterator>
+		void add(Iterator first, Iterator last) {
+			neighbors.insert(neighbors.end(), first, last);
+			offsets.push_back(neighbors.size());
+		}
+
+		std::size_t getSize() const {
+			return offsets.size() - 1;
+		}
+
+		CSRGraph finish();
+
+	private:
+		std::vector<std::size_t> offsets;
+		std::vector<std::size_t> neighbors;
+};
+
+#endif
+
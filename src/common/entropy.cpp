@@ -1,50 +1,365 @@
 #include "entropy.hpp"
 
+#include <algorithm>
+#include <cassert>
 #include <cmath>
-#include <unordered_map>
+#include <cstdint>
+#include <limits>
 
-typedef std::unordered_map<std::vector<std::size_t>, data_t> density_t;
+typedef std::uint64_t cellkey_t;
+typedef std::vector<std::size_t> counts_t;
 
-density_t calcDensity(const subspace_t& subspace, const std::vector<discretedim_t>& data) {
-	density_t density;
+// cell spaces up to that size (or the number of rows, if bigger) get counted in a plain array
+constexpr std::size_t DENSE_LIMIT = 1 << 16;
+
+// Counts packed cell keys in a flat open addressing table (linear probing). Every key gets a dense id
+// (order of first appearance), which also makes it usable to compress keys.
+class DensityTable {
+	public:
+		// expected = upper bound for the number of distinct keys, table never grows
+		explicit DensityTable(std::size_t expected) :
+			keys(),
+			ids(),
+			counts(),
+			mask(0) {
+			std::size_t capacity = 16;
+			while (capacity < 2 * expected) {
+				capacity <<= 1;
+			}
+			keys.assign(capacity, 0);
+			ids.resize(capacity);
+			counts.reserve(expected);
+			mask = capacity - 1;
+		}
+
+		std::size_t insert(cellkey_t key) {
+			// stored keys are shifted by one, 0 marks empty slots
+			cellkey_t k = key + 1;
+			std::size_t slot = static_cast<std::size_t>(hashFinalize(k) & mask);
+
+			while (true) {
+				if (keys[slot] == k) {
+					++counts[ids[slot]];
+					return ids[slot];
+				} else if (keys[slot] == 0) {
+					keys[slot] = k;
+					ids[slot] = counts.size();
+					counts.push_back(1);
+					return ids[slot];
+				}
+				slot = (slot + 1) & mask;
+			}
+		}
+
+		std::size_t getSize() const {
+			return counts.size();
+		}
+
+		counts_t& getCounts() {
+			return counts;
+		}
+
+	private:
+		std::vector<cellkey_t> keys;
+		std::vector<std::size_t> ids;
+		counts_t counts;
+		std::size_t mask;
+};
+
+std::size_t calcBinCount(const discretedim_t& dim) {
+	std::size_t max = 0;
+
+	for (std::size_t segment = 0; segment < dim->getSegmentCount(); ++segment) {
+		std::size_t size = dim->getSegmentFillSize(segment);
+		discretedimObj_t::segment_t* data = dim->getSegment(segment);
+
+		for (std::size_t i = 0; i < size; ++i) {
+			max = std::max(max, (*data)[i]);
+		}
+	}
+
+	return max + 1;
+}
+
+std::vector<std::size_t> calcBinCounts(const std::vector<discretedim_t>& data) {
+	std::vector<std::size_t> result;
+	result.reserve(data.size());
+
+	for (const auto& dim : data) {
+		result.push_back(calcBinCount(dim));
+	}
+
+	return result;
+}
+
+// counts all keys, dense array if the key space is small enough
+counts_t countKeys(const cellkey_t* keys, std::size_t n, cellkey_t keySpace) {
+	if (keySpace <= std::max(DENSE_LIMIT, n)) {
+		counts_t counts(static_cast<std::size_t>(keySpace), 0);
+		for (std::size_t i = 0; i < n; ++i) {
+			++counts[static_cast<std::size_t>(keys[i])];
+		}
+		return counts;
+	} else {
+		DensityTable table(std::min(static_cast<cellkey_t>(n), keySpace));
+		for (std::size_t i = 0; i < n; ++i) {
+			table.insert(keys[i]);
+		}
+		return std::move(table.getCounts());
+	}
+}
+
+// Integer count of every (non-empty) cell. Cell coordinates get packed into one mixed-radix key using the
+// bin counts as radices. If the full key space does not fit into 64 bits, the keys of the first columns
+// get compressed to dense ids (at most one per row) before more columns are added.
+counts_t calcDensity(const subspace_t& subspace, const std::vector<discretedim_t>& data, const std::vector<std::size_t>& binCounts) {
 	std::size_t nSegments = data.at(0)->getSegmentCount();
 	std::size_t n = data.at(0)->getSize();
-	data_t step = 1.0 / static_cast<data_t>(n);
-	std::vector<size_t> pos(subspace.size());
 
-	for (std::size_t segment = 0; segment < nSegments; ++segment) {
-		std::size_t size = data.at(0)->getSegmentFillSize(segment);
+	// key space of the whole subspace, if it fits
+	cellkey_t keySpace = 1;
+	bool overflow = false;
+	for (std::size_t s : subspace) {
+		cellkey_t radix = std::max(static_cast<std::size_t>(1), binCounts.at(s));
+		if (keySpace > std::numeric_limits<cellkey_t>::max() / radix) {
+			overflow = true;
+			break;
+		}
+		keySpace *= radix;
+	}
+
+	// fast path: pack and count segment by segment
+	if (!overflow && (keySpace <= std::max(DENSE_LIMIT, n))) {
+		counts_t counts(static_cast<std::size_t>(keySpace), 0);
+		std::vector<cellkey_t> keys;
+
+		for (std::size_t segment = 0; segment < nSegments; ++segment) {
+			std::size_t size = data.at(0)->getSegmentFillSize(segment);
+			keys.assign(size, 0);
 
-		typename std::vector<discretedimObj_t::segment_t*> segmentPtrs(subspace.size());
-		std::size_t ptrIter = 0;
-		for (std::size_t s : subspace) {
-			const discretedim_t& dim = data.at(s);
-			segmentPtrs[ptrIter++] = dim->getSegment(segment);
+			// column by column, so every segment is read sequentially
+			cellkey_t multiplier = 1;
+			for (std::size_t s : subspace) {
+				discretedimObj_t::segment_t* segmentPtr = data.at(s)->getSegment(segment);
+				for (std::size_t i = 0; i < size; ++i) {
+					keys[i] += (*segmentPtr)[i] * multiplier;
+				}
+				multiplier *= std::max(static_cast<std::size_t>(1), binCounts[s]);
+			}
+
+			for (std::size_t i = 0; i < size; ++i) {
+				++counts[static_cast<std::size_t>(keys[i])];
+			}
 		}
 
-		for (std::size_t i = 0; i < size; ++i) {
-			std::size_t posIter = 0;
+		return counts;
+	}
 
-			for (const auto& segmentPtr : segmentPtrs) {
-				pos[posIter++] = (*segmentPtr)[i];
+	// general path: keys for all rows, compressed when the next column would overflow them
+	std::vector<cellkey_t> keys(n, 0);
+	cellkey_t currentSpace = 1;
+	for (std::size_t s : subspace) {
+		cellkey_t radix = std::max(static_cast<std::size_t>(1), binCounts[s]);
+		if (currentSpace > std::numeric_limits<cellkey_t>::max() / radix) {
+			DensityTable table(std::min(static_cast<cellkey_t>(n), currentSpace));
+			for (auto& key : keys) {
+				key = table.insert(key);
 			}
+			currentSpace = table.getSize();
+		}
 
-			density[pos] += step;
+		std::size_t offset = 0;
+		for (std::size_t segment = 0; segment < nSegments; ++segment) {
+			std::size_t size = data.at(0)->getSegmentFillSize(segment);
+			discretedimObj_t::segment_t* segmentPtr = data.at(s)->getSegment(segment);
+			for (std::size_t i = 0; i < size; ++i) {
+				keys[offset + i] = keys[offset + i] * radix + (*segmentPtr)[i];
+			}
+			offset += size;
 		}
+		currentSpace *= radix;
 	}
 
-	return density;
+	return countKeys(keys.data(), n, currentSpace);
 }
 
-data_t calcEntropy(const subspace_t& subspace, const std::vector<discretedim_t>& data) {
-	density_t density = calcDensity(subspace, data);
+template <typename Count>
+data_t entropyFromCounts(const std::vector<Count>& counts, std::size_t n) {
+	data_t step = 1.0 / static_cast<data_t>(n);
 	data_t result = 0.0;
 
-	for (const auto& kv : density) {
-		data_t p = kv.second;
-		result -= p * log2(p);
+	for (auto count : counts) {
+		if (count > 0) {
+			data_t p = static_cast<data_t>(count) * step;
+			result -= p * log2(p);
+		}
 	}
 
 	return result;
 }
 
+data_t calcEntropy(const subspace_t& subspace, const std::vector<discretedim_t>& data, const std::vector<std::size_t>& binCounts) {
+	return entropyFromCounts(calcDensity(subspace, data, binCounts), data.at(0)->getSize());
+}
+
+data_t calcEntropy(const subspace_t& subspace, const std::vector<discretedim_t>& data) {
+	// only determine the bin counts of the used dimensions
+	std::vector<std::size_t> binCounts(data.size(), 0);
+	for (std::size_t s : subspace) {
+		binCounts.at(s) = calcBinCount(data.at(s));
+	}
+
+	return calcEntropy(subspace, data, binCounts);
+}
+
+// new cell of every row = (old cell, value of dim), getId turns the combined key into the new (dense) cell id
+template <typename GetId>
+void refineIds(const std::vector<discretedim_t>& data, std::size_t dim, const std::uint32_t* baseIds, cellkey_t radix, std::uint32_t* ids, GetId getId) {
+	std::size_t offset = 0;
+
+	for (std::size_t segment = 0; segment < data.at(0)->getSegmentCount(); ++segment) {
+		std::size_t size = data.at(0)->getSegmentFillSize(segment);
+		discretedimObj_t::segment_t* segmentPtr = data.at(dim)->getSegment(segment);
+
+		for (std::size_t i = 0; i < size; ++i) {
+			cellkey_t key = (baseIds ? baseIds[offset + i] : 0) * radix + (*segmentPtr)[i];
+			ids[offset + i] = getId(key);
+		}
+
+		offset += size;
+	}
+}
+
+struct EntropyEngine::Partition {
+	// cell id of every row and number of rows per cell
+	std::vector<std::uint32_t> ids;
+	std::vector<std::uint32_t> counts;
+
+	std::size_t getMemory() const {
+		return (ids.size() + counts.size()) * sizeof(std::uint32_t);
+	}
+};
+
+EntropyEngine::EntropyEngine(const std::vector<discretedim_t>& _data, const std::vector<std::size_t>& _binCounts, std::size_t _memoryBudget) :
+	data(_data),
+	binCounts(_binCounts),
+	memoryBudget(_memoryBudget),
+	bitmapIndex(nullptr),
+	cache(),
+	lru(),
+	memoryUsed(0),
+	mutex() {
+	assert(data.at(0)->getSize() <= std::numeric_limits<std::uint32_t>::max());
+}
+
+void EntropyEngine::setBitmapIndex(const BitmapIndex* index) {
+	bitmapIndex = index;
+}
+
+EntropyEngine::partition_t EntropyEngine::refine(const Partition* base, std::size_t dim) const {
+	std::size_t n = data.at(0)->getSize();
+	cellkey_t radix = std::max(static_cast<std::size_t>(1), binCounts.at(dim));
+	cellkey_t keySpace = (base ? base->counts.size() : 1) * radix;
+
+	std::shared_ptr<Partition> result = std::make_shared<Partition>();
+	result->ids.resize(n);
+
+	if (keySpace <= std::max(DENSE_LIMIT, n)) {
+		const std::uint32_t noId = std::numeric_limits<std::uint32_t>::max();
+		std::vector<std::uint32_t> map(static_cast<std::size_t>(keySpace), noId);
+		auto& counts = result->counts;
+
+		refineIds(data, dim, base ? base->ids.data() : nullptr, radix, result->ids.data(), [&](cellkey_t key) {
+				std::uint32_t& id = map[static_cast<std::size_t>(key)];
+				if (id == noId) {
+					id = static_cast<std::uint32_t>(counts.size());
+					counts.push_back(0);
+				}
+				++counts[id];
+				return id;
+			});
+	} else {
+		DensityTable table(std::min(static_cast<cellkey_t>(n), keySpace));
+
+		refineIds(data, dim, base ? base->ids.data() : nullptr, radix, result->ids.data(), [&](cellkey_t key) {
+				return static_cast<std::uint32_t>(table.insert(key));
+			});
+
+		const auto& counts = table.getCounts();
+		result->counts.assign(counts.begin(), counts.end());
+	}
+
+	return result;
+}
+
+EntropyEngine::partition_t EntropyEngine::lookup(const prefix_t& prefix) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto iter = cache.find(prefix);
+	if (iter == cache.end()) {
+		return partition_t();
+	}
+
+	lru.splice(lru.begin(), lru, iter->second.lruPos);
+	return iter->second.partition;
+}
+
+void EntropyEngine::store(const prefix_t& prefix, partition_t partition) {
+	std::size_t memory = partition->getMemory();
+	if (memory > memoryBudget) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (cache.find(prefix) != cache.end()) {
+		return;
+	}
+
+	lru.push_front(prefix);
+	cache[prefix] = CacheEntry{std::move(partition), lru.begin()};
+	memoryUsed += memory;
+
+	// evict least recently used partitions
+	while (memoryUsed > memoryBudget) {
+		auto iter = cache.find(lru.back());
+		memoryUsed -= iter->second.partition->getMemory();
+		cache.erase(iter);
+		lru.pop_back();
+	}
+}
+
+data_t EntropyEngine::calcEntropy(const subspace_t& subspace) {
+	prefix_t dims(subspace.begin(), subspace.end());
+	if (dims.empty()) {
+		return 0.0;
+	}
+
+	// small cell spaces: AND + popcount over the bitmaps, without touching the partition cache
+	if (bitmapIndex) {
+		std::vector<std::size_t> counts;
+		if (bitmapIndex->calcCounts(subspace, counts)) {
+			return entropyFromCounts(counts, data.at(0)->getSize());
+		}
+	}
+
+	// longest cached prefix
+	prefix_t prefix(dims);
+	partition_t current;
+	while (!prefix.empty()) {
+		current = lookup(prefix);
+		if (current) {
+			break;
+		}
+		prefix.pop_back();
+	}
+
+	// refine with the remaining columns, all intermediate partitions are useful prefixes
+	for (std::size_t i = prefix.size(); i < dims.size(); ++i) {
+		current = refine(current.get(), dims[i]);
+		prefix.push_back(dims[i]);
+		store(prefix, current);
+	}
+
+	return entropyFromCounts(current->counts, data.at(0)->getSize());
+}
+
@@ -1,11 +1,60 @@
 #ifndef ENTROPY_HPP
 #define ENTROPY_HPP
 
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
+#include "bitmapindex.hpp"
 #include "sys.hpp"
 
+// number of bins (maximum value + 1) of every dimension, calculate once and pass it to calcEntropy
+std::vector<std::size_t> calcBinCounts(const std::vector<discretedim_t>& data);
+
+data_t calcEntropy(const subspace_t& subspace, const std::vector<discretedim_t>& data, const std::vector<std::size_t>& binCounts);
 data_t calcEntropy(const subspace_t& subspace, const std::vector<discretedim_t>& data);
 
+// Entropy calculation that keeps the row partitions (cell id of every row) of already seen subspaces. The
+// partition of a subspace gets derived from the longest cached prefix by refining it with one column at a
+// time, each step is O(rows). Cached partitions are evicted in LRU order to stay within the memory budget.
+// Subspaces with few cells can be counted with an optional bitmap index instead. calcEntropy is thread-safe.
+class EntropyEngine {
+	public:
+		EntropyEngine(const std::vector<discretedim_t>& data, const std::vector<std::size_t>& binCounts, std::size_t memoryBudget);
+
+		// use index for all subspaces it accepts (nullptr = disable), index has to outlive the engine
+		void setBitmapIndex(const BitmapIndex* index);
+
+		data_t calcEntropy(const subspace_t& subspace);
+
+	private:
+		struct Partition;
+		typedef std::vector<std::size_t> prefix_t;
+		typedef std::shared_ptr<const Partition> partition_t;
+
+		struct CacheEntry {
+			partition_t partition;
+			std::list<prefix_t>::iterator lruPos;
+		};
+
+		const std::vector<discretedim_t>& data;
+		const std::vector<std::size_t>& binCounts;
+		std::size_t memoryBudget;
+		const BitmapIndex* bitmapIndex;
+
+		// guarded by mutex, most recently used prefixes first
+		std::unordered_map<prefix_t, CacheEntry> cache;
+		std::list<prefix_t> lru;
+		std::size_t memoryUsed;
+		std::mutex mutex;
+
+		partition_t refine(const Partition* base, std::size_t dim) const;
+		partition_t lookup(const prefix_t& prefix);
+		void store(const prefix_t& prefix, partition_t partition);
+};
+
 #endif
 
@@ -0,0 +1,149 @@
+#ifndef FLATSET_HPP
+#define FLATSET_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+// Open addressing hash set (linear probing). Elements are stored densely in insertion order, the table only holds
+// (hash, index) pairs, so iteration is a plain vector scan and growing never rehashes elements. There is no erase.
+template <typename Key, typename Hash = std::hash<Key>, typename Equal = std::equal_to<Key>>
+class FlatSet {
+	public:
+		typedef Key value_type;
+		typedef typename std::vector<Key>::const_iterator const_iterator;
+		typedef const_iterator iterator;
+
+		FlatSet() :
+			values(),
+			slots(minCapacity, Slot{0, noIndex}),
+			mask(minCapacity - 1) {}
+
+		template <typename Iter>
+		FlatSet(Iter first, Iter last) :
+			FlatSet() {
+			for (; first != last; ++first) {
+				insert(*first);
+			}
+		}
+
+		// returns false if an equal element was already part of the set
+		bool insert(const Key& key) {
+			return insert(Key(key));
+		}
+
+		bool insert(Key&& key) {
+			std::uint64_t hash = Hash()(key);
+			if (findIf(hash, [&key](const Key& obj){return Equal()(obj, key);})) {
+				return false;
+			}
+
+			values.push_back(std::move(key));
+			link(hash, values.size() - 1);
+			return true;
+		}
+
+		// element with that hash for which pred is true (nullptr if none), allows lookups without building a key
+		template <typename Pred>
+		const Key* findIf(std::uint64_t hash, Pred pred) const {
+			for (std::size_t slot = static_cast<std::size_t>(hash) & mask; slots[slot].index != noIndex; slot = (slot + 1) & mask) {
+				if ((slots[slot].hash == hash) && pred(values[slots[slot].index])) {
+					return &values[slots[slot].index];
+				}
+			}
+			return nullptr;
+		}
+
+		const Key* find(const Key& key) const {
+			return findIf(Hash()(key), [&key](const Key& obj){return Equal()(obj, key);});
+		}
+
+		std::size_t count(const Key& key) const {
+			return find(key) ? 1 : 0;
+		}
+
+		void reserve(std::size_t n) {
+			if (2 * n > slots.size()) {
+				rehash(n);
+			}
+			values.reserve(n);
+		}
+
+		std::size_t size() const {
+			return values.size();
+		}
+
+		bool empty() const {
+			return values.empty();
+		}
+
+		std::size_t bucket_count() const {
+			return slots.size();
+		}
+
+		const_iterator begin() const {
+			return values.begin();
+		}
+
+		const_iterator end() const {
+			return values.end();
+		}
+
+	private:
+		static constexpr std::size_t minCapacity = 16;
+		static constexpr std::size_t noIndex = static_cast<std::size_t>(-1);
+
+		struct Slot {
+			std::uint64_t hash;
+			std::size_t index;
+		};
+
+		std::vector<Key> values;
+		std::vector<Slot> slots;
+		std::size_t mask;
+
+		// keeps the load factor at <= 0.5
+		void link(std::uint64_t hash, std::size_t index) {
+			if (2 * values.size() > slots.size()) {
+				rehash(values.size());
+			}
+			place(Slot{hash, index});
+		}
+
+		void place(const Slot& s) {
+			std::size_t slot = static_cast<std::size_t>(s.hash) & mask;
+			while (slots[slot].index != noIndex) {
+				slot = (slot + 1) & mask;
+			}
+			slots[slot] = s;
+		}
+
+		// new table for at least n elements, linked entries get moved with their stored hashes
+		void rehash(std::size_t n) {
+			std::size_t capacity = minCapacity;
+			while (capacity < 2 * n) {
+				capacity <<= 1;
+			}
+
+			std::vector<Slot> old(capacity, Slot{0, noIndex});
+			old.swap(slots);
+			mask = capacity - 1;
+
+			for (const auto& s : old) {
+				if (s.index != noIndex) {
+					place(s);
+				}
+			}
+		}
+};
+
+template <typename Key, typename Hash, typename Equal>
+constexpr std::size_t FlatSet<Key, Hash, Equal>::minCapacity;
+
+template <typename Key, typename Hash, typename Equal>
+constexpr std::size_t FlatSet<Key, Hash, Equal>::noIndex;
+
+#endif
+
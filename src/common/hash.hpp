@@ -1,11 +1,47 @@
 #ifndef HASH_HPP
 #define HASH_HPP
 
+#include <cstdint>
 #include <functional>
 #include <list>
 #include <set>
 #include <vector>
 
+// start value for hashing id sequences
+constexpr std::uint64_t HASH_SEED = 0x243f6a8885a308d3ULL;
+
+// 64x64 => 128 bit multiply, folded to 64 bit (wyhash style)
+inline std::uint64_t hashMum(std::uint64_t a, std::uint64_t b) {
+	unsigned __int128 r = static_cast<unsigned __int128>(a) * b;
+	return static_cast<std::uint64_t>(r) ^ static_cast<std::uint64_t>(r >> 64);
+}
+
+// appends one id to the hash of a sequence, all output bits depend on all input bits
+inline std::uint64_t hashCombine(std::uint64_t hash, std::uint64_t id) {
+	return hashMum(hash ^ 0xa0761d6478bd642fULL, id ^ 0xe7037ed1a0b428dbULL);
+}
+
+// finalizer for single integer keys (murmur3 fmix64)
+inline std::uint64_t hashFinalize(std::uint64_t x) {
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	x ^= x >> 33;
+	return x;
+}
+
+template <typename Iter>
+std::uint64_t hashIds(Iter first, Iter last) {
+	std::uint64_t result = HASH_SEED;
+
+	for (; first != last; ++first) {
+		result = hashCombine(result, static_cast<std::uint64_t>(*first));
+	}
+
+	return result;
+}
+
 template<>
 struct std::hash<std::list<std::size_t>> {
 	std::size_t operator()(const std::list<std::size_t>& obj) const;
@@ -0,0 +1,184 @@
+#ifndef SUBSPACE_HPP
+#define SUBSPACE_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <limits>
+#include <memory>
+
+#include "hash.hpp"
+
+// Ordered list of dimension ids (32 bit). Small subspaces are stored inline, bigger ones in one heap block. The
+// hash (= hashIds over all dims) gets updated on every modification, so hashing a subspace is free.
+class Subspace {
+	public:
+		typedef std::uint32_t dim_t;
+		typedef dim_t value_type;
+		typedef const dim_t* const_iterator;
+		typedef const_iterator iterator;
+
+		Subspace() :
+			n(0),
+			capacity(inlineSize),
+			hash(HASH_SEED),
+			heap() {}
+
+		Subspace(std::initializer_list<std::size_t> dims) :
+			Subspace() {
+			assign(dims.begin(), dims.end());
+		}
+
+		template <typename Iter>
+		Subspace(Iter first, Iter last) :
+			Subspace() {
+			assign(first, last);
+		}
+
+		Subspace(const Subspace& obj) :
+			Subspace() {
+			assign(obj.begin(), obj.end());
+		}
+
+		Subspace(Subspace&& obj) noexcept :
+			Subspace() {
+			*this = std::move(obj);
+		}
+
+		Subspace& operator=(const Subspace& obj) {
+			if (this != &obj) {
+				assign(obj.begin(), obj.end());
+			}
+			return *this;
+		}
+
+		Subspace& operator=(Subspace&& obj) noexcept {
+			if (this != &obj) {
+				if (obj.heap) {
+					heap = std::move(obj.heap);
+					capacity = obj.capacity;
+				} else {
+					heap.reset();
+					capacity = inlineSize;
+					std::copy(obj.local, obj.local + obj.n, local);
+				}
+				n = obj.n;
+				hash = obj.hash;
+
+				obj.clear();
+			}
+			return *this;
+		}
+
+		template <typename Iter>
+		void assign(Iter first, Iter last) {
+			clear();
+			for (; first != last; ++first) {
+				push_back(static_cast<std::size_t>(*first));
+			}
+		}
+
+		void push_back(std::size_t dim) {
+			assert(dim <= std::numeric_limits<dim_t>::max());
+
+			if (n == capacity) {
+				grow();
+			}
+			data()[n++] = static_cast<dim_t>(dim);
+			hash = hashCombine(hash, dim);
+		}
+
+		void clear() {
+			heap.reset();
+			capacity = inlineSize;
+			n = 0;
+			hash = HASH_SEED;
+		}
+
+		std::size_t size() const {
+			return n;
+		}
+
+		bool empty() const {
+			return n == 0;
+		}
+
+		const_iterator begin() const {
+			return data();
+		}
+
+		const_iterator end() const {
+			return data() + n;
+		}
+
+		dim_t operator[](std::size_t i) const {
+			return data()[i];
+		}
+
+		dim_t front() const {
+			return data()[0];
+		}
+
+		dim_t back() const {
+			return data()[n - 1];
+		}
+
+		std::size_t getHash() const {
+			return hash;
+		}
+
+		// bytes used by this object, including the heap block
+		std::size_t getMemory() const {
+			return sizeof(Subspace) + (heap ? capacity * sizeof(dim_t) : 0);
+		}
+
+		bool operator==(const Subspace& obj) const {
+			return (hash == obj.hash) && (n == obj.n) && std::equal(begin(), end(), obj.begin());
+		}
+
+		bool operator!=(const Subspace& obj) const {
+			return !(*this == obj);
+		}
+
+		bool operator<(const Subspace& obj) const {
+			return std::lexicographical_compare(begin(), end(), obj.begin(), obj.end());
+		}
+
+	private:
+		static constexpr std::size_t inlineSize = 8;
+
+		std::uint32_t n;
+		std::uint32_t capacity;
+		std::uint64_t hash;
+		dim_t local[inlineSize];
+		std::unique_ptr<dim_t[]> heap;
+
+		dim_t* data() {
+			return heap ? heap.get() : local;
+		}
+
+		const dim_t* data() const {
+			return heap ? heap.get() : local;
+		}
+
+		void grow() {
+			std::uint32_t newCapacity = 2 * capacity;
+			std::unique_ptr<dim_t[]> newHeap(new dim_t[newCapacity]);
+			std::copy(begin(), end(), newHeap.get());
+			heap = std::move(newHeap);
+			capacity = newCapacity;
+		}
+};
+
+template<>
+struct std::hash<Subspace> {
+	std::size_t operator()(const Subspace& obj) const {
+		return obj.getHash();
+	}
+};
+
+#endif
+
@@ -0,0 +1,92 @@
+#include <string>
+#include <utility>
+
+#include "candidatestore.hpp"
+
+CandidateStore::CandidateStore(std::shared_ptr<greycore::Database> _db, const std::string& _name, std::size_t _memoryBudget) :
+	db(_db),
+	name(_name),
+	memoryBudget(_memoryBudget),
+	memoryUsed(0),
+	chunks(),
+	count(0),
+	spilled(0) {}
+
+void CandidateStore::push(std::vector<subspace_t>& subspaces) {
+	std::size_t memory = 0;
+	for (const auto& ss : subspaces) {
+		memory += ss.getMemory();
+	}
+	count += subspaces.size();
+
+	Chunk chunk;
+	if (memoryUsed + memory <= memoryBudget) {
+		chunk.subspaces = std::move(subspaces);
+		memoryUsed += memory;
+	} else {
+		chunk.dim = db->createDim<std::size_t>(name + "." + std::to_string(chunks.size()));
+		for (const auto& ss : subspaces) {
+			chunk.dim->add(ss.size());
+			for (auto d : ss) {
+				chunk.dim->add(d);
+			}
+		}
+		++spilled;
+	}
+	subspaces.clear();
+	subspaces.shrink_to_fit();
+
+	chunks.push_back(std::move(chunk));
+}
+
+void CandidateStore::forEach(std::function<void(std::vector<subspace_t>&)> fun) {
+	for (auto& chunk : chunks) {
+		if (chunk.dim) {
+			load(chunk);
+		}
+
+		fun(chunk.subspaces);
+
+		chunk.subspaces.clear();
+		chunk.subspaces.shrink_to_fit();
+		chunk.dim.reset();
+	}
+}
+
+std::size_t CandidateStore::getCount() const {
+	return count;
+}
+
+std::size_t CandidateStore::getSpilled() const {
+	return spilled;
+}
+
+void CandidateStore::load(Chunk& chunk) const {
+	chunk.subspaces.clear();
+
+	// records can span segments, so keep the parser state between them
+	subspace_t current;
+	std::size_t remaining = 0;
+	bool header = true;
+	for (std::size_t segment = 0; segment < chunk.dim->getSegmentCount(); ++segment) {
+		std::size_t size = chunk.dim->getSegmentFillSize(segment);
+		chunkdimObj_t::segment_t* data = chunk.dim->getSegment(segment);
+
+		for (std::size_t i = 0; i < size; ++i) {
+			if (header) {
+				remaining = (*data)[i];
+				header = false;
+			} else {
+				current.push_back((*data)[i]);
+				--remaining;
+			}
+
+			if (!header && (remaining == 0)) {
+				chunk.subspaces.push_back(std::move(current));
+				current.clear();
+				header = true;
+			}
+		}
+	}
+}
+
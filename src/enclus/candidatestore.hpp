@@ -0,0 +1,48 @@
+#ifndef CANDIDATESTORE_HPP
+#define CANDIDATESTORE_HPP
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "greycore/database.hpp"
+
+#include "sys.hpp"
+
+// Keeps the candidate chunks of one level in order. Chunks stay in memory until the memory budget is used up,
+// all later chunks get spilled to a scratch DB (one dim per chunk: size, id1, id2, ... for every subspace).
+class CandidateStore {
+	public:
+		CandidateStore(std::shared_ptr<greycore::Database> db, const std::string& name, std::size_t memoryBudget);
+
+		// takes over the content of chunk
+		void push(std::vector<subspace_t>& chunk);
+
+		// call fun for every chunk (in push order), memory of a chunk gets freed after it was processed
+		void forEach(std::function<void(std::vector<subspace_t>&)> fun);
+
+		std::size_t getCount() const;
+		std::size_t getSpilled() const;
+
+	private:
+		typedef greycore::Dim<std::size_t> chunkdimObj_t;
+
+		struct Chunk {
+			std::vector<subspace_t> subspaces;
+			std::shared_ptr<chunkdimObj_t> dim;
+		};
+
+		std::shared_ptr<greycore::Database> db;
+		std::string name;
+		std::size_t memoryBudget;
+		std::size_t memoryUsed;
+		std::vector<Chunk> chunks;
+		std::size_t count;
+		std::size_t spilled;
+
+		void load(Chunk& chunk) const;
+};
+
+#endif
+
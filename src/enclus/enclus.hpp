@@ -2,13 +2,12 @@
 #define ENCLUS_HPP
 
 #include <list>
-#include <unordered_set>
 #include <vector>
 
+#include "flatset.hpp"
 #include "sys.hpp"
-#include "hash.hpp"
 
-typedef std::unordered_set<subspace_t> subspaces_t;
+typedef FlatSet<subspace_t> subspaces_t;
 typedef std::vector<data_t> entropyCache_t;
 
 #endif
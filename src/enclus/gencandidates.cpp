@@ -1,23 +1,55 @@
 #include "gencandidates.hpp"
 
-#include <list>
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
 
 #include <tbb/blocked_range.h>
 #include <tbb/parallel_reduce.h>
 
-bool prune(const subspace_t& subspace, const subspaces_t& last) {
-	for (std::size_t idxD = 0; idxD < subspace.size(); ++idxD) {
-		// gen subsubspace
-		subspace_t test;
-		std::size_t i = 0;
-		for (std::size_t d : subspace) {
-			if (i != idxD) {
-				test.push_back(d);
-			}
-			++i;
+// all subspaces of one level (same size k), flat and in lexicographic order
+struct Level {
+	std::size_t k;
+	std::vector<std::size_t> dims;
+
+	std::size_t getSize() const {
+		return (k > 0) ? (dims.size() / k) : 0;
+	}
+
+	const std::size_t* get(std::size_t i) const {
+		return dims.data() + i * k;
+	}
+};
+
+// is candidate (k elements) without the element at position skip part of the last level?
+bool containsSubset(const std::size_t* candidate, std::size_t k, std::size_t skip, const subspaces_t& last) {
+	// same hash as the stored subspace would have, without building it
+	std::uint64_t hash = HASH_SEED;
+	for (std::size_t i = 0; i < k; ++i) {
+		if (i != skip) {
+			hash = hashCombine(hash, candidate[i]);
 		}
+	}
+
+	return last.findIf(hash, [candidate, k, skip](const subspace_t& ss) {
+			auto iter = ss.begin();
+			for (std::size_t i = 0; i < k; ++i) {
+				if (i != skip) {
+					if (*iter != candidate[i]) {
+						return false;
+					}
+					++iter;
+				}
+			}
+			return true;
+		}) != nullptr;
+}
 
-		if (last.find(test) == last.cend()) {
+// Candidate = prefix + last element of two subspaces with equal prefix. Dropping one of the last two elements
+// gives the parents, so only the subsubspaces that drop a prefix element have to be tested.
+bool prune(const std::size_t* candidate, std::size_t k, const subspaces_t& last) {
+	for (std::size_t skip = 0; skip + 2 < k; ++skip) {
+		if (!containsSubset(candidate, k, skip, last)) {
 			return true;
 		}
 	}
@@ -27,76 +59,108 @@ bool prune(const subspace_t& subspace, const subspaces_t& last) {
 
 class TBBHelperGC {
 	public:
-		std::list<subspace_t> result;
+		std::vector<subspace_t> result;
+		std::size_t skipped;
 
-		TBBHelperGC(const subspaces_t& _last, const std::vector<subspace_t> _lastVector) :
+		TBBHelperGC(const Level& _level, const subspaces_t& _last, const std::vector<std::size_t>& _groupEnds, const GraphFilter* _filter) :
+			result(),
+			skipped(0),
+			level(_level),
 			last(_last),
-			lastVector(_lastVector) {}
+			groupEnds(_groupEnds),
+			filter(_filter) {}
 
 		TBBHelperGC(TBBHelperGC& obj, tbb::split) :
+			result(),
+			skipped(0),
+			level(obj.level),
 			last(obj.last),
-			lastVector(obj.lastVector) {}
+			groupEnds(obj.groupEnds),
+			filter(obj.filter) {}
 
 		void operator()(const tbb::blocked_range<std::size_t>& range) {
+			std::size_t k = level.k;
+			std::vector<std::size_t> candidate(k + 1);
+
 			for (auto i = range.begin(); i != range.end(); ++i) {
-				const auto& ss1 = lastVector.at(i);
-
-				for (std::size_t j = i + 1; j != lastVector.size(); ++j) {
-					const auto& ss2 = lastVector.at(j);
-
-					subspace_t next;
-					auto iter1 = ss1.begin();
-					auto iter2 = ss2.begin();
-					std::size_t x1;
-					std::size_t x2;
-					while ((iter1 != ss1.end()) && (iter2 != ss2.end())) {
-						x1 = *iter1;
-						x2 = *iter2;
-
-						++iter1;
-						++iter2;
-
-						if (x1 == x2) {
-							next.push_back(x1);
-						} else {
-							break;
-						}
+				// join with all following subspaces of the group (same first k - 1 elements, bigger last one)
+				std::copy(level.get(i), level.get(i) + k, candidate.begin());
+
+				for (std::size_t j = i + 1; j < groupEnds[i]; ++j) {
+					candidate[k] = level.get(j)[k - 1];
+
+					// both parents are cliques, so only the new pair has to be connected
+					if (filter && !filter->connected(candidate[k - 1], candidate[k])) {
+						++skipped;
+						continue;
 					}
 
-					if ((iter1 == ss1.end()) && (iter2 == ss2.end())) {
-						if (x1 < x2) {
-							next.push_back(x1);
-							next.push_back(x2);
-						} else {
-							next.push_back(x2);
-							next.push_back(x1);
-						}
-
-						if (!prune(next, last)) {
-							result.push_back(next);
-						}
+					if (!prune(candidate.data(), k + 1, last)) {
+						result.push_back(subspace_t(candidate.begin(), candidate.end()));
 					}
 				}
 			}
 		}
 
 		void join(TBBHelperGC& obj) {
-			this->result.splice(this->result.end(), obj.result);
+			this->result.insert(this->result.end(), std::make_move_iterator(obj.result.begin()), std::make_move_iterator(obj.result.end()));
+			this->skipped += obj.skipped;
 		}
 
 	private:
+		const Level& level;
 		const subspaces_t& last;
-		const std::vector<subspace_t> lastVector;
+		const std::vector<std::size_t>& groupEnds;
+		const GraphFilter* filter;
 };
 
 
-std::vector<subspace_t> genCandidates(const subspaces_t& last) {
-	std::vector<subspace_t> lastVector(last.begin(), last.end());
-	TBBHelperGC helper(last, lastVector);
-	parallel_reduce(tbb::blocked_range<std::size_t>(0, lastVector.size()), helper);
+std::size_t genCandidates(const subspaces_t& last, std::size_t chunkSize, const GraphFilter* filter, std::function<void(std::vector<subspace_t>&)> sink) {
+	if (last.empty()) {
+		return 0;
+	}
 
-	std::vector<subspace_t> result(helper.result.begin(), helper.result.end());
-	return result;
-}
+	// flat copy of the level, sorted so equal prefixes form consecutive groups
+	Level level;
+	level.k = last.begin()->size();
+	std::vector<subspace_t> sorted(last.begin(), last.end());
+	std::sort(sorted.begin(), sorted.end());
+	level.dims.reserve(sorted.size() * level.k);
+	for (const auto& ss : sorted) {
+		level.dims.insert(level.dims.end(), ss.begin(), ss.end());
+	}
+	sorted.clear();
+	sorted.shrink_to_fit();
+
+	// end of the group of every subspace
+	std::size_t n = level.getSize();
+	std::vector<std::size_t> groupEnds(n);
+	for (std::size_t i = n; i > 0; --i) {
+		bool sameGroup = (i < n) && std::equal(level.get(i - 1), level.get(i - 1) + level.k - 1, level.get(i));
+		groupEnds[i - 1] = sameGroup ? groupEnds[i] : i;
+	}
 
+	// batches of rows with about chunkSize joined pairs
+	std::size_t skipped = 0;
+	std::size_t begin = 0;
+	while (begin < n) {
+		std::size_t end = begin;
+		std::size_t pairs = 0;
+		while ((end < n) && ((end == begin) || (pairs < chunkSize))) {
+			pairs += groupEnds[end] - end - 1;
+			++end;
+		}
+
+		TBBHelperGC helper(level, last, groupEnds, filter);
+		parallel_reduce(tbb::blocked_range<std::size_t>(begin, end), helper);
+		if (!helper.result.empty()) {
+			sink(helper.result);
+		}
+		skipped += helper.skipped;
+
+		begin = end;
+	}
+
+	return skipped;
+}
 
@@ -1,11 +1,16 @@
 #ifndef GENCANDIDATES_HPP
 #define GENCANDIDATES_HPP
 
+#include <functional>
 #include <vector>
 
 #include "enclus.hpp"
+#include "graphfilter.hpp"
 
-std::vector<subspace_t> genCandidates(const subspaces_t& last);
+// Calls sink for the candidates of the next level, in lexicographic order and in chunks that come from about
+// chunkSize joined pairs (before pruning). With a filter, only cliques of its graph are generated (the last level
+// has to consist of cliques already). Returns the number of joined pairs that were skipped by the filter.
+std::size_t genCandidates(const subspaces_t& last, std::size_t chunkSize, const GraphFilter* filter, std::function<void(std::vector<subspace_t>&)> sink);
 
 #endif
 
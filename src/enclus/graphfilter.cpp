@@ -0,0 +1,51 @@
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "graphfilter.hpp"
+
+constexpr std::size_t GraphFilter::maxMatrixBits;
+
+GraphFilter::GraphFilter(const CSRGraph& graph, std::size_t nColumns) :
+	n(nColumns),
+	matrix(),
+	adjacency() {
+	if (graph.getSize() != n) {
+		throw std::runtime_error("Graph has " + std::to_string(graph.getSize()) + " vertices, but data has " + std::to_string(n) + " columns");
+	}
+
+	// both directions of every edge, without self loops
+	std::vector<std::vector<std::size_t>> rows(n);
+	for (std::size_t v = 0; v < n; ++v) {
+		for (auto w : graph.get(v)) {
+			if (v != w) {
+				rows[v].push_back(w);
+				rows[w].push_back(v);
+			}
+		}
+	}
+
+	CSRBuilder builder;
+	for (auto& row : rows) {
+		std::sort(row.begin(), row.end());
+		row.erase(std::unique(row.begin(), row.end()), row.end());
+		builder.add(row.begin(), row.end());
+		std::vector<std::size_t>().swap(row);
+	}
+	adjacency = builder.finish();
+
+	if (n * n <= maxMatrixBits) {
+		matrix.assign((n * n + 63) / 64, 0);
+		for (std::size_t v = 0; v < n; ++v) {
+			for (auto w : adjacency.get(v)) {
+				std::size_t bit = v * n + w;
+				matrix[bit / 64] |= static_cast<std::uint64_t>(1) << (bit % 64);
+			}
+		}
+	}
+}
+
+std::size_t GraphFilter::getEdgeCount() const {
+	return adjacency.getEdgeCount() / 2;
+}
+
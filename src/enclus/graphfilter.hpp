@@ -0,0 +1,39 @@
+#ifndef GRAPHFILTER_HPP
+#define GRAPHFILTER_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "csrgraph.hpp"
+
+// Undirected column graph for the candidate generation: a subspace is only explored if it is a clique. Small
+// graphs are stored as a bit matrix (O(1) lookup), bigger ones as symmetric CSR graph (binary search).
+class GraphFilter {
+	public:
+		GraphFilter(const CSRGraph& graph, std::size_t nColumns);
+
+		bool connected(std::size_t a, std::size_t b) const {
+			if (!matrix.empty()) {
+				std::size_t bit = a * n + b;
+				return (matrix[bit / 64] >> (bit % 64)) & 1;
+			} else {
+				auto neighbors = adjacency.get(a);
+				return std::binary_search(neighbors.begin(), neighbors.end(), b);
+			}
+		}
+
+		// number of undirected edges
+		std::size_t getEdgeCount() const;
+
+	private:
+		// biggest bit matrix (64MB)
+		static constexpr std::size_t maxMatrixBits = static_cast<std::size_t>(1) << 29;
+
+		std::size_t n;
+		std::vector<std::uint64_t> matrix;
+		CSRGraph adjacency;
+};
+
+#endif
+
@@ -1,11 +1,14 @@
 #include <algorithm>
 #include <cassert>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
 #include <limits>
 #include <list>
 #include <memory>
 #include <ostream>
 #include <sstream>
+#include <string>
 #include <unordered_set>
 #include <vector>
 
@@ -17,11 +20,15 @@
 
 #include "sys.hpp"
 #include "tracer.hpp"
+#include "bitmapindex.hpp"
+#include "candidatestore.hpp"
+#include "csrgraph.hpp"
 #include "entropy.hpp"
 
 #include "enclus.hpp"
 #include "disretize.hpp"
 #include "gencandidates.hpp"
+#include "graphfilter.hpp"
 
 #include "greycore/database.hpp"
 #include "greycore/dim.hpp"
@@ -30,7 +37,7 @@
 namespace gc = greycore;
 namespace po = boost::program_options;
 
-data_t calcInterest(const subspace_t subspace, data_t entropy, const entropyCache_t& entropyCache) {
+data_t calcInterest(const subspace_t& subspace, data_t entropy, const entropyCache_t& entropyCache) {
 	data_t aggr = 0.0;
 
 	for (size_t d : subspace) {
@@ -47,9 +54,9 @@ class TBBHelper {
 		data_t minEntropy = std::numeric_limits<data_t>::infinity();
 		data_t maxInterest = 0;
 
-		TBBHelper(std::vector<subspace_t>& _subspacesCurrent, const std::vector<discretedim_t>& _ddims, const entropyCache_t& _entropyCache, data_t _omega, data_t _epsilon, std::size_t _xi) :
+		TBBHelper(std::vector<subspace_t>& _subspacesCurrent, EntropyEngine& _entropyEngine, const entropyCache_t& _entropyCache, data_t _omega, data_t _epsilon, std::size_t _xi) :
 			subspacesCurrent(_subspacesCurrent),
-			ddims(_ddims),
+			entropyEngine(_entropyEngine),
 			entropyCache(_entropyCache),
 			omega(_omega),
 			epsilon(_epsilon),
@@ -57,7 +64,7 @@ class TBBHelper {
 
 		TBBHelper(TBBHelper& obj, tbb::split) :
 			subspacesCurrent(obj.subspacesCurrent),
-			ddims(obj.ddims),
+			entropyEngine(obj.entropyEngine),
 			entropyCache(obj.entropyCache),
 			omega(obj.omega),
 			epsilon(obj.epsilon),
@@ -66,7 +73,7 @@ class TBBHelper {
 		void operator()(const tbb::blocked_range<std::size_t>& range) {
 			for (auto i = range.begin(); i != range.end(); ++i) {
 				auto& subspace = subspacesCurrent[i];
-				data_t entropy = calcEntropy(subspace, ddims);
+				data_t entropy = entropyEngine.calcEntropy(subspace);
 				minEntropy = std::min(minEntropy, entropy);
 
 				if (entropy < omega) {
@@ -91,7 +98,7 @@ class TBBHelper {
 
 	private:
 		std::vector<subspace_t>& subspacesCurrent;
-		const std::vector<discretedim_t>& ddims;
+		EntropyEngine& entropyEngine;
 		const entropyCache_t& entropyCache;
 		data_t omega;
 		data_t epsilon;
@@ -103,10 +110,15 @@ int main(int argc, char **argv) {
 	std::string cfgOutput;
 	std::string cfgDbData;
 	std::string cfgDbDiscrete;
+	std::string cfgDbScratch;
+	std::string cfgGraphFilter;
 	data_t cfgEpsilon;
 	data_t cfgOmega;
 	std::size_t cfgXi;
 	std::size_t cfgThreads;
+	std::size_t cfgPartitionCache;
+	std::size_t cfgBitmapCells;
+	std::size_t cfgMemoryBudget;
 
 	// parse program options
 	po::options_description poDesc("Options");
@@ -126,6 +138,16 @@ int main(int argc, char **argv) {
 			po::value(&cfgDbDiscrete)->default_value("discrete.db"),
 			"DB file that stores discrete data"
 		)
+		(
+			"dbscratch",
+			po::value(&cfgDbScratch)->default_value("scratch.db"),
+			"DB file that stores spilled candidates (must not exist, removed after the run)"
+		)
+		(
+			"graphFilter",
+			po::value(&cfgGraphFilter)->default_value(""),
+			"GraBaSS graph DB, only explore subspaces that are cliques of its phase0 graph (empty = disabled)"
+		)
 		(
 			"epsilon",
 			po::value(&cfgEpsilon)->default_value(1.0, "1.0"),
@@ -141,6 +163,21 @@ int main(int argc, char **argv) {
 			po::value(&cfgXi)->default_value(10),
 			"Xi"
 		)
+		(
+			"partitionCache",
+			po::value(&cfgPartitionCache)->default_value(256),
+			"Memory budget for cached row partitions of the entropy calculation in MB"
+		)
+		(
+			"bitmapCells",
+			po::value(&cfgBitmapCells)->default_value(0),
+			"Build a bitmap index and use it for subspaces with up to that many cells (0 = disabled, ~256 pays off for 2D subspaces)"
+		)
+		(
+			"memoryBudget",
+			po::value(&cfgMemoryBudget)->default_value(1024),
+			"Memory budget for the candidates of one level in MB, more candidates get spilled to the scratch DB (spills of all levels stay on disk until the end of the run)"
+		)
 		(
 			"threads",
 			po::value(&cfgThreads)->default_value(0),
@@ -167,6 +204,14 @@ int main(int argc, char **argv) {
 		return EXIT_SUCCESS;
 	}
 
+	// the scratch DB gets removed after the run, so it must not be an existing file
+	if (std::ifstream(cfgDbScratch)) {
+		std::cout << "Error:" << std::endl
+			<< "Scratch DB " << cfgDbScratch << " already exists, it would be overwritten and removed." << std::endl
+			<< "Remove it or use a different --dbscratch." << std::endl;
+		return EXIT_FAILURE;
+	}
+
 	// setup tbb
 	int threads = static_cast<int>(cfgThreads);
 	if (threads == 0) {
@@ -190,6 +235,7 @@ int main(int argc, char **argv) {
 		tPhase.reset(new Tracer("open", tMain));
 		auto dbData = std::make_shared<gc::Database>(cfgDbData);
 		auto dbDiscrete = std::make_shared<gc::Database>(cfgDbDiscrete);
+		auto dbScratch = std::make_shared<gc::Database>(cfgDbScratch);
 		std::ofstream outfile(cfgOutput);
 
 		auto dimNameList = dbData->getIndexDims();
@@ -204,15 +250,41 @@ int main(int argc, char **argv) {
 		// discretize data
 		tPhase.reset(new Tracer("discretize", tMain));
 		std::vector<discretedim_t> ddims = discretize(dims, dbDiscrete, cfgXi);
+		std::vector<std::size_t> binCounts = calcBinCounts(ddims);
+		EntropyEngine entropyEngine(ddims, binCounts, cfgPartitionCache << 20);
+
+		// optional bitmap index for small cell spaces
+		std::unique_ptr<BitmapIndex> bitmapIndex;
+		if (cfgBitmapCells > 0) {
+			tPhase.reset(new Tracer("bitmapIndex", tMain));
+			bitmapIndex.reset(new BitmapIndex(ddims, binCounts, cfgBitmapCells));
+			entropyEngine.setBitmapIndex(bitmapIndex.get());
+		}
+
+		// optional column graph, restricts the lattice to its cliques
+		std::unique_ptr<GraphFilter> graphFilter;
+		if (!cfgGraphFilter.empty()) {
+			tPhase.reset(new Tracer("graphFilter", tMain));
+			std::cout << "Load graph filter: " << std::flush;
+			auto dbGraph = std::make_shared<gc::Database>(cfgGraphFilter);
+			auto graph = std::make_shared<gc::Graph>(dbGraph->getDim<std::size_t>("phase0.1"), dbGraph->getDim<std::size_t>("phase0.2"));
+			graphFilter.reset(new GraphFilter(CSRGraph(graph), dims.size()));
+			std::cout << "done (" << graphFilter->getEdgeCount() << " edges)" << std::endl;
+		}
+
+		// candidates of the current level, max. memory of one chunk = 1/16 budget
+		std::size_t memoryBudget = cfgMemoryBudget << 20;
+		std::size_t chunkSize = std::max(static_cast<std::size_t>(1024), memoryBudget / (16 * sizeof(subspace_t)));
+		std::unique_ptr<CandidateStore> candidates(new CandidateStore(dbScratch, "depth1", memoryBudget));
 
 		// generate 1D subspaces and calc entropy for them
 		tPhase.reset(new Tracer("1d", tMain));
 		std::cout << "Build 1D subspaces + fill entropy cache: " << std::flush;
-		std::vector<subspace_t> subspacesCurrent;
+		std::vector<subspace_t> subspaces1d;
 		entropyCache_t entropyCache;
 		for (std::size_t i = 0; i < dims.size(); ++i) {
-			subspacesCurrent.push_back({i});
-			entropyCache.push_back(calcEntropy({i}, ddims));
+			subspaces1d.push_back({i});
+			entropyCache.push_back(entropyEngine.calcEntropy({i}));
 
 			// report progress
 			if (i % 1000 == 0) {
@@ -221,55 +293,80 @@ int main(int argc, char **argv) {
 				std::cout << "." << std::flush;
 			}
 		}
+		candidates->push(subspaces1d);
 		std::cout << "done" << std::endl;
 
-		// rounds
+		// rounds, interesting subspaces get written as soon as they are found
 		tPhase.reset(new Tracer("tree", tMain));
 		std::cout << "Tree phase: " << std::endl;
-		std::list<subspace_t> result;
+		std::size_t nWritten = 0;
+		auto writeSubspace = [&outfile, &nWritten](const subspace_t& ss) {
+				bool first = true;
+				for (auto dim : ss) {
+					if (first) {
+						first = false;
+					} else {
+						outfile << ",";
+					}
+					outfile << dim;
+				}
+				outfile << "\n";
+				++nWritten;
+			};
 		std::size_t depth = 1;
+		std::size_t graphSkipped = 0;
 		data_t minEntropy = std::numeric_limits<data_t>::infinity();
 		data_t maxInterest = 0;
-		while (!subspacesCurrent.empty()) {
-			std::cout << "depth=" << depth << ", candidatesNow=" << subspacesCurrent.size() << std::flush;
+		while (candidates->getCount() > 0) {
+			std::cout << "depth=" << depth << ", candidatesNow=" << candidates->getCount() << std::flush;
+			if (candidates->getSpilled() > 0) {
+				std::cout << ", spilledChunks=" << candidates->getSpilled() << std::flush;
+			}
 
-			TBBHelper helper(subspacesCurrent, ddims, entropyCache, cfgOmega, cfgEpsilon, cfgXi);
-			parallel_reduce(tbb::blocked_range<std::size_t>(0, subspacesCurrent.size()), helper);
+			// evaluate chunk by chunk, collect the base of the next level
+			subspaces_t dict;
+			candidates->forEach([&](std::vector<subspace_t>& chunk) {
+					TBBHelper helper(chunk, entropyEngine, entropyCache, cfgOmega, cfgEpsilon, cfgXi);
+					parallel_reduce(tbb::blocked_range<std::size_t>(0, chunk.size()), helper);
 
-			result.splice(result.end(), helper.result);
+					for (const auto& ss : helper.result) {
+						writeSubspace(ss);
+					}
+					for (auto& ss : helper.subspacesNext) {
+						dict.insert(std::move(ss));
+					}
 
-			subspaces_t dict(helper.subspacesNext.begin(), helper.subspacesNext.end());
+					minEntropy = std::min(minEntropy, helper.minEntropy);
+					maxInterest = std::max(maxInterest, helper.maxInterest);
+				});
+			candidates.reset();
 			std::cout << ", baseNext=" << dict.size() << std::flush;
-			subspacesCurrent = genCandidates(dict);
+
+			// next level
 			++depth;
+			candidates.reset(new CandidateStore(dbScratch, "depth" + std::to_string(depth), memoryBudget));
+			std::size_t skipped = genCandidates(dict, chunkSize, graphFilter.get(), [&candidates](std::vector<subspace_t>& chunk) {
+					candidates->push(chunk);
+				});
+			if (graphFilter) {
+				std::cout << ", graphSkipped=" << skipped << std::flush;
+				graphSkipped += skipped;
+			}
 
 			// report progress
-			minEntropy = std::min(minEntropy, helper.minEntropy);
-			maxInterest = std::max(maxInterest, helper.maxInterest);
 			std::cout << std::endl;
 		}
-		std::cout << "done (minEntropy=" << minEntropy << ", maxInterest=" << maxInterest << ")" << std::endl;
-
-		// ok, so lets write the results
-		tPhase.reset(new Tracer("output", tMain));
-		std::cout << "Write result: " << std::flush;
-		for (auto ss : result) {
-			bool first = true;
-			for (auto dim : ss) {
-				if (first) {
-					first = false;
-				} else {
-					outfile << ",";
-				}
-				outfile << dim;
-			}
-			outfile << std::endl;
+		outfile.flush();
+		std::cout << "done (minEntropy=" << minEntropy << ", maxInterest=" << maxInterest << ", written=" << nWritten;
+		if (graphFilter) {
+			std::cout << ", graphSkipped=" << graphSkipped;
 		}
-		std::cout << "done" << std::endl;
+		std::cout << ")" << std::endl;
 
 		std::cout << "Cleanup and Sync: " << std::flush;
 		// end of block => free dims and db
 	}
+	std::remove(cfgDbScratch.c_str());
 	std::cout << "done" << std::endl;
 
 	std::cout << std::endl << "Time profile:" << std::endl << timerProfile.str() << std::endl;
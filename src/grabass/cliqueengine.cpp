@@ -0,0 +1,346 @@
+#include <algorithm>
+
+#include "cliqueengine.hpp"
+
+constexpr std::size_t CliqueSubproblem::wordBits;
+constexpr std::size_t CliqueEngine::noId;
+constexpr std::size_t CliqueArena::chunkSize;
+constexpr std::size_t CliqueBranch::checkInterval;
+
+inline std::size_t popcount(cs_word_t w) {
+	return static_cast<std::size_t>(__builtin_popcountll(w));
+}
+
+inline std::size_t lowestBit(cs_word_t w) {
+	return static_cast<std::size_t>(__builtin_ctzll(w));
+}
+
+inline cs_word_t bitOf(std::size_t i) {
+	return static_cast<cs_word_t>(1) << (i % CliqueSubproblem::wordBits);
+}
+
+CliqueArena::CliqueArena() :
+	chunks(1, std::vector<cs_word_t>(chunkSize)),
+	current(0),
+	used(0) {}
+
+cs_word_t* CliqueArena::allocate(std::size_t n) {
+	// skip to the next chunk that is big enough, keep all chunks for reuse
+	while (used + n > chunks[current].size()) {
+		++current;
+		used = 0;
+		if (current == chunks.size()) {
+			chunks.push_back(std::vector<cs_word_t>(std::max(chunkSize, n)));
+		}
+	}
+
+	cs_word_t* result = chunks[current].data() + used;
+	used += n;
+	return result;
+}
+
+CliqueVertexResult::CliqueVertexResult(std::size_t _v, const CliqueContext* _context) :
+	v(_v),
+	context(_context),
+	aborted(false),
+	mutex(),
+	cliques() {}
+
+CliqueVertexResult::~CliqueVertexResult() {
+	if (isAborted()) {
+		context->cancellation->abort(v);
+	} else {
+		for (const auto& clique : cliques) {
+			context->sink->push(clique);
+		}
+	}
+}
+
+void CliqueVertexResult::push(const std::vector<std::size_t>& clique) {
+	std::lock_guard<std::mutex> lock(mutex);
+	cliques.push_back(clique);
+}
+
+CliqueBranch::CliqueBranch(const CliqueContext* _context) :
+	context(_context),
+	sub(),
+	result(),
+	nodes(0),
+	start(),
+	arena(nullptr),
+	r() {}
+
+void CliqueBranch::reset(std::shared_ptr<const CliqueSubproblem> _sub, std::shared_ptr<CliqueVertexResult> _result, const std::vector<std::size_t>& _r, const cs_word_t* p, const cs_word_t* x) {
+	sub = std::move(_sub);
+	result = std::move(_result);
+	nodes = 0;
+	r = _r;
+
+	start.resize(sub->nWordsP + sub->nWords);
+	std::copy(p, p + sub->nWordsP, start.begin());
+	std::copy(x, x + sub->nWords, start.begin() + static_cast<std::ptrdiff_t>(sub->nWordsP));
+}
+
+void CliqueBranch::run() {
+	arena = &context->arenas->local();
+	recurse(start.data(), start.data() + sub->nWordsP);
+	arena = nullptr;
+	sub.reset();
+	result.reset();
+}
+
+void CliqueBranch::report() {
+	if (result) {
+		result->push(r);
+	} else {
+		context->sink->push(r);
+	}
+}
+
+bool CliqueBranch::cancelled() {
+	if (!result) {
+		return false;
+	}
+
+	// another branch of this vertex was cancelled already, or the deadline is reached
+	bool stop = result->isAborted() || context->cancellation->isCancelled() || ((++nodes % checkInterval == 0) && context->cancellation->expired());
+	if (stop) {
+		result->abort();
+	}
+	return stop;
+}
+
+void CliqueBranch::recurse(cs_word_t* p, cs_word_t* x) {
+	std::size_t nWordsP = sub->nWordsP;
+	std::size_t nWords = sub->nWords;
+
+	if (cancelled()) {
+		return;
+	}
+
+	// count P
+	std::size_t pCount = 0;
+	for (std::size_t i = 0; i < nWordsP; ++i) {
+		pCount += popcount(p[i]);
+	}
+
+	// R + P is the biggest clique this branch can find
+	if (r.size() + pCount < context->minSize) {
+		return;
+	}
+
+	if (pCount == 0) {
+		if (std::all_of(x, x + nWords, [](cs_word_t w){return w == 0;})) {
+			report();
+		}
+		return;
+	}
+
+	// choose pivot from P and X with maximal |P & N(u)|
+	std::size_t pivot = 0;
+	std::size_t pivotValue = 0;
+	bool pivotFound = false;
+	for (std::size_t i = 0; (i < nWords) && (pivotValue < pCount); ++i) {
+		cs_word_t bits = (i < nWordsP) ? (p[i] | x[i]) : x[i];
+
+		while ((bits != 0) && (pivotValue < pCount)) {
+			std::size_t u = i * CliqueSubproblem::wordBits + lowestBit(bits);
+			bits &= bits - 1;
+
+			const cs_word_t* neighbors = sub->row(u);
+			std::size_t value = 0;
+			for (std::size_t j = 0; j < nWordsP; ++j) {
+				value += popcount(p[j] & neighbors[j]);
+			}
+
+			if (!pivotFound || (value > pivotValue)) {
+				pivot = u;
+				pivotValue = value;
+				pivotFound = true;
+			}
+		}
+	}
+
+	// candidates = P \ N(pivot), all memory of this frame comes from the arena
+	CliqueArenaFrame frame(arena);
+	cs_word_t* cand = arena->allocate(nWordsP);
+	cs_word_t* pNew = arena->allocate(nWordsP + nWords);
+	cs_word_t* xNew = pNew + nWordsP;
+	const cs_word_t* pivotNeighbors = sub->row(pivot);
+	for (std::size_t i = 0; i < nWordsP; ++i) {
+		cand[i] = p[i] & ~pivotNeighbors[i];
+	}
+
+	// recursion loop
+	for (std::size_t i = 0; i < nWordsP; ++i) {
+		cs_word_t bits = cand[i];
+
+		while (bits != 0) {
+			std::size_t v = i * CliqueSubproblem::wordBits + lowestBit(bits);
+			bits &= bits - 1;
+
+			// build p, x
+			const cs_word_t* neighbors = sub->row(v);
+			std::size_t pNewCount = 0;
+			for (std::size_t j = 0; j < nWordsP; ++j) {
+				pNew[j] = p[j] & neighbors[j];
+				pNewCount += popcount(pNew[j]);
+			}
+			for (std::size_t j = 0; j < nWords; ++j) {
+				xNew[j] = x[j] & neighbors[j];
+			}
+
+			r.push_back(sub->globalIds[v]);
+			if (pNewCount >= context->spawnCutoff) {
+				// big branch => own task, so idle threads can steal it
+				std::shared_ptr<CliqueBranch> task(new CliqueBranch(context));
+				task->reset(sub, result, r, pNew, xNew);
+				context->group->run([task]() {
+						task->run();
+					});
+			} else {
+				// call recursive function
+				recurse(pNew, xNew);
+			}
+			r.pop_back();
+
+			if (result && result->isAborted()) {
+				return;
+			}
+
+			// prepare next round
+			p[i] &= ~bitOf(v);
+			x[i] |= bitOf(v);
+			--pCount;
+			if (r.size() + pCount < context->minSize) {
+				return;
+			}
+		}
+	}
+}
+
+CliqueEngine::CliqueEngine(const CSRGraph* _data, const CliqueContext* _context) :
+	data(_data),
+	context(_context),
+	localIds(),
+	sub(),
+	branch(_context) {}
+
+void CliqueEngine::prepare(std::size_t v) {
+	if (localIds.size() != data->getSize()) {
+		localIds.assign(data->getSize(), noId);
+	}
+
+	// reuse old subproblem if no spawned branch is using it anymore
+	if (!sub || (sub.use_count() > 1)) {
+		sub = std::make_shared<CliqueSubproblem>();
+	}
+
+	auto neighbors = data->get(v);
+	auto xEnd = std::lower_bound(neighbors.begin(), neighbors.end(), v);
+	auto splitPoint = std::upper_bound(xEnd, neighbors.end(), v);
+
+	// P
+	auto& globalIds = sub->globalIds;
+	globalIds.assign(splitPoint, neighbors.end());
+	std::size_t nP = globalIds.size();
+	std::size_t nWordsP = (nP + CliqueSubproblem::wordBits - 1) / CliqueSubproblem::wordBits;
+	for (std::size_t l = 0; l < nP; ++l) {
+		localIds[globalIds[l]] = l;
+	}
+
+	// X, drop all vertices without connection to P (they can never block a clique in P)
+	auto& rowsX = sub->rowsX;
+	rowsX.clear();
+	for (auto iter = neighbors.begin(); iter != xEnd; ++iter) {
+		std::size_t offset = rowsX.size();
+		rowsX.resize(offset + nWordsP, 0);
+		bool connected = false;
+
+		for (auto w : data->get(*iter)) {
+			std::size_t l = localIds[w];
+			if (l != noId) {
+				rowsX[offset + l / CliqueSubproblem::wordBits] |= bitOf(l);
+				connected = true;
+			}
+		}
+
+		if (connected) {
+			globalIds.push_back(*iter);
+		} else {
+			rowsX.resize(offset);
+		}
+	}
+	for (std::size_t l = nP; l < globalIds.size(); ++l) {
+		localIds[globalIds[l]] = l;
+	}
+	std::size_t nWords = (globalIds.size() + CliqueSubproblem::wordBits - 1) / CliqueSubproblem::wordBits;
+
+	// P rows
+	auto& rowsP = sub->rowsP;
+	rowsP.assign(nP * nWords, 0);
+	for (std::size_t l = 0; l < nP; ++l) {
+		cs_word_t* target = rowsP.data() + l * nWords;
+
+		for (auto w : data->get(globalIds[l])) {
+			std::size_t ll = localIds[w];
+			if (ll != noId) {
+				target[ll / CliqueSubproblem::wordBits] |= bitOf(ll);
+			}
+		}
+	}
+
+	// cleanup lookup table
+	for (auto g : globalIds) {
+		localIds[g] = noId;
+	}
+
+	sub->nP = nP;
+	sub->nWordsP = nWordsP;
+	sub->nWords = nWords;
+}
+
+void CliqueEngine::search(std::size_t v) {
+	auto neighbors = data->get(v);
+
+	// no larger neighbors => only a (maximal) clique if there are no neighbors at all
+	if (neighbors.empty() || (neighbors[neighbors.size() - 1] <= v)) {
+		if (neighbors.empty() && (context->minSize <= 1)) {
+			context->sink->push(std::vector<std::size_t>({v}));
+		}
+		return;
+	}
+
+	// v + larger neighbors too small => nothing to report
+	auto splitPoint = std::upper_bound(neighbors.begin(), neighbors.end(), v);
+	if (1 + static_cast<std::size_t>(neighbors.end() - splitPoint) < context->minSize) {
+		return;
+	}
+
+	prepare(v);
+
+	// first level: P = 0..nP-1, X = nP..k-1
+	CliqueArena* arena = &context->arenas->local();
+	CliqueArenaFrame frame(arena);
+	cs_word_t* p = arena->allocate(sub->nWordsP);
+	cs_word_t* x = arena->allocate(sub->nWords);
+	std::fill(p, p + sub->nWordsP, 0);
+	std::fill(x, x + sub->nWords, 0);
+	for (std::size_t l = 0; l < sub->globalIds.size(); ++l) {
+		if (l < sub->nP) {
+			p[l / CliqueSubproblem::wordBits] |= bitOf(l);
+		} else {
+			x[l / CliqueSubproblem::wordBits] |= bitOf(l);
+		}
+	}
+
+	// with a time budget the cliques of v are held back until all its branches are done
+	std::shared_ptr<CliqueVertexResult> result;
+	if (context->cancellation) {
+		result = std::make_shared<CliqueVertexResult>(v, context);
+	}
+
+	branch.reset(sub, std::move(result), std::vector<std::size_t>({v}), p, x);
+	branch.run();
+}
+
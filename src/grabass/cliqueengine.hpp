@@ -0,0 +1,235 @@
+#ifndef CLIQUEENGINE_HPP
+#define CLIQUEENGINE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/task_group.h>
+
+#include "cliquestore.hpp"
+#include "csrgraph.hpp"
+
+typedef std::uint64_t cs_word_t;
+
+// Local subproblem of one top-level vertex v: P = neighbors > v, X = neighbors < v (only those that are
+// connected to P), remapped to local ids 0..|P|-1 (P) and |P|..k-1 (X). Immutable after creation, so
+// it can be shared by all branches that get spawned for v.
+struct CliqueSubproblem {
+	static constexpr std::size_t wordBits = 64;
+
+	// local id => global id
+	std::vector<std::size_t> globalIds;
+
+	// size of P and word count of P and P+X bitsets
+	std::size_t nP;
+	std::size_t nWordsP;
+	std::size_t nWords;
+
+	// local adjacency: P rows cover P+X, X rows only cover P
+	std::vector<cs_word_t> rowsP;
+	std::vector<cs_word_t> rowsX;
+
+	const cs_word_t* row(std::size_t u) const {
+		return (u < nP) ? (rowsP.data() + u * nWords) : (rowsX.data() + (u - nP) * nWordsP);
+	}
+};
+
+// Per thread stack allocator for the bitsets of the recursion. Memory is handed out from reused chunks and
+// a frame releases everything it allocated by resetting to its mark, so the recursion does not touch the
+// global allocator after warm-up.
+class CliqueArena {
+	public:
+		typedef std::pair<std::size_t, std::size_t> mark_t;
+
+		CliqueArena();
+
+		cs_word_t* allocate(std::size_t n);
+
+		mark_t getMark() const {
+			return std::make_pair(current, used);
+		}
+
+		void release(mark_t mark) {
+			current = mark.first;
+			used = mark.second;
+		}
+
+	private:
+		static constexpr std::size_t chunkSize = 1 << 16;
+
+		std::vector<std::vector<cs_word_t>> chunks;
+		std::size_t current;
+		std::size_t used;
+};
+
+// releases all arena memory of one stack frame
+class CliqueArenaFrame {
+	public:
+		explicit CliqueArenaFrame(CliqueArena* _arena) :
+			arena(_arena),
+			mark(_arena->getMark()) {}
+
+		~CliqueArenaFrame() {
+			arena->release(mark);
+		}
+
+	private:
+		CliqueArena* arena;
+		CliqueArena::mark_t mark;
+};
+
+typedef tbb::enumerable_thread_specific<CliqueArena> cs_arenas_t;
+
+typedef std::chrono::steady_clock::time_point cs_deadline_t;
+
+// Deadline of a clique search. Once it is reached, all running branches stop; top-level vertices that were not
+// finished get collected in aborted, so they can be searched again later.
+class CliqueCancellation {
+	public:
+		explicit CliqueCancellation(cs_deadline_t _deadline) :
+			deadline(_deadline),
+			cancelled(false),
+			mutex(),
+			aborted() {}
+
+		// checks the clock, only call it every now and then
+		bool expired() {
+			if (!cancelled.load(std::memory_order_relaxed) && (std::chrono::steady_clock::now() >= deadline)) {
+				cancelled.store(true, std::memory_order_relaxed);
+			}
+			return isCancelled();
+		}
+
+		bool isCancelled() const {
+			return cancelled.load(std::memory_order_relaxed);
+		}
+
+		void abort(std::size_t v) {
+			std::lock_guard<std::mutex> lock(mutex);
+			aborted.push_back(v);
+		}
+
+		const std::vector<std::size_t>& getAborted() const {
+			return aborted;
+		}
+
+	private:
+		cs_deadline_t deadline;
+		std::atomic<bool> cancelled;
+		std::mutex mutex;
+		std::vector<std::size_t> aborted;
+};
+
+// shared state of one clique search
+struct CliqueContext {
+	tbb::task_group* group;
+	cs_arenas_t* arenas;
+	CliqueSink* sink;
+
+	// branches with at least that many candidates in P get spawned as separate tasks
+	std::size_t spawnCutoff;
+
+	// only report cliques with at least that many members, prune branches that cannot reach it
+	std::size_t minSize;
+
+	// nullptr = no time budget
+	CliqueCancellation* cancellation;
+};
+
+// Cliques of one top-level vertex while its search can still get cancelled. They are handed to the sink when the
+// last branch of the vertex releases this object, or dropped (and the vertex marked as aborted) if any branch was
+// cancelled. Every clique belongs to exactly one top-level vertex, so a later search of the aborted vertices
+// reports each of them exactly once.
+class CliqueVertexResult {
+	public:
+		CliqueVertexResult(std::size_t v, const CliqueContext* context);
+		~CliqueVertexResult();
+
+		void push(const std::vector<std::size_t>& clique);
+
+		void abort() {
+			aborted.store(true, std::memory_order_relaxed);
+		}
+
+		bool isAborted() const {
+			return aborted.load(std::memory_order_relaxed);
+		}
+
+	private:
+		std::size_t v;
+		const CliqueContext* context;
+		std::atomic<bool> aborted;
+		std::mutex mutex;
+		std::vector<std::vector<std::size_t>> cliques;
+};
+
+// Bron-Kerbosch with Tomita pivoting on bitsets, starting at one (P, R, X) state of a subproblem.
+class CliqueBranch {
+	public:
+		explicit CliqueBranch(const CliqueContext* context);
+
+		void reset(std::shared_ptr<const CliqueSubproblem> sub, std::shared_ptr<CliqueVertexResult> result, const std::vector<std::size_t>& r, const cs_word_t* p, const cs_word_t* x);
+		void run();
+
+	private:
+		// recursion nodes between two deadline checks
+		static constexpr std::size_t checkInterval = 1024;
+
+		const CliqueContext* context;
+		std::shared_ptr<const CliqueSubproblem> sub;
+
+		// collects the cliques if the search can get cancelled (nullptr otherwise)
+		std::shared_ptr<CliqueVertexResult> result;
+
+		// recursion nodes of this branch
+		std::size_t nodes;
+
+		// P and X of the starting state (modified in place by the first level)
+		std::vector<cs_word_t> start;
+
+		// arena of the thread that runs this branch
+		CliqueArena* arena;
+
+		// current clique (global ids)
+		std::vector<std::size_t> r;
+
+		void recurse(cs_word_t* p, cs_word_t* x);
+		void report();
+
+		// true if the branch has to stop (the vertex is marked as aborted then)
+		bool cancelled();
+};
+
+// per thread engine that builds the subproblems for top-level vertices and runs them
+class CliqueEngine {
+	public:
+		CliqueEngine(const CSRGraph* data, const CliqueContext* context);
+
+		// find all maximal cliques where v is the smallest member
+		void search(std::size_t v);
+
+	private:
+		static constexpr std::size_t noId = static_cast<std::size_t>(-1);
+
+		const CSRGraph* data;
+		const CliqueContext* context;
+
+		// global id => local id (noId if not part of the current subproblem), kept clean between searches
+		std::vector<std::size_t> localIds;
+
+		// reused as long as no spawned branch holds a reference
+		std::shared_ptr<CliqueSubproblem> sub;
+		CliqueBranch branch;
+
+		void prepare(std::size_t v);
+};
+
+#endif
+
@@ -1,115 +1,51 @@
 #include <algorithm>
 #include <atomic>
-#include <cassert>
+#include <chrono>
 #include <iostream>
 #include <memory>
-#include <set>
-#include <unordered_set>
 #include <vector>
 
-#include <tbb/blocked_range.h>
-#include <tbb/parallel_reduce.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/task_arena.h>
+#include <tbb/task_group.h>
 
+#include "cliqueengine.hpp"
 #include "cliquesearcher.hpp"
 
-namespace gc = greycore;
-
-typedef std::vector<std::vector<std::size_t>> cs_workdataobj_t;
-typedef cs_workdataobj_t* cs_workdata_t;
 typedef std::atomic<std::size_t> cs_progressobj_t;
 typedef cs_progressobj_t* cs_progress_t;
 
-cs_workdata_t createWorkdata(std::shared_ptr<gc::Graph> graph) {
-	auto result = new cs_workdataobj_t(graph->getSize());
-
-	for (std::size_t i = 0; i < graph->getSize(); ++i) {
-		auto tmp = graph->get(i);
-		std::vector<std::size_t> v(tmp.begin(), tmp.end());
-		v.shrink_to_fit();
-		(*result)[i] = move(v);
-	}
-
-	return result;
-}
-
-inline void testDifference(std::size_t& winnerValue, std::list<std::size_t>& recursionElements, const std::set<std::size_t>& p, std::vector<std::size_t>& neighbors) {
-	std::list<std::size_t> test;
-	std::set_difference(p.begin(), p.end(), neighbors.begin(), neighbors.end(), back_inserter(test));
+typedef tbb::enumerable_thread_specific<CliqueEngine> cs_engines_t;
 
-	std::size_t s = test.size();
-	if (s < winnerValue) {
-		winnerValue = s;
-		recursionElements = move(test);
-	}
-}
-
-std::list<std::vector<std::size_t>> bronKerboschPivot(std::set<std::size_t>&& p, std::vector<std::size_t>&& r, std::set<std::size_t>&& x, cs_workdata_t data) {
-	std::list<std::vector<std::size_t>> result;
+// branches with at least that many vertices in P run as own tasks
+constexpr std::size_t CS_SPAWN_CUTOFF = 48;
 
-	if (p.empty() && x.empty()) {
-		r.shrink_to_fit();
-		result.push_back(r);
-	} else {
-		// choose pivot
-		std::size_t winnerValue = p.size() + 1;
-		std::list<std::size_t> recursionElements;
-		for (auto u : p) {
-			testDifference(winnerValue, recursionElements, p, (*data)[u]);
-		}
-		for (auto u : x) {
-			testDifference(winnerValue, recursionElements, p, (*data)[u]);
-		}
-
-		// recursion loop
-		for (auto v : recursionElements) {
-			auto& neighbors = (*data)[v];
-
-			// build p, r, x
-			std::set<std::size_t> pNew;
-			std::set_intersection(p.begin(), p.end(), neighbors.begin(), neighbors.end(), inserter(pNew, pNew.end()));
-			std::vector<std::size_t> rNew(r);
-			rNew.push_back(v);
-			std::set<std::size_t> xNew;
-			std::set_intersection(x.begin(), x.end(), neighbors.begin(), neighbors.end(), inserter(xNew, xNew.end()));
-
-			// call recursive function and store results
-			result.splice(result.end(), bronKerboschPivot(move(pNew), move(rNew), move(xNew), data));
-
-			// prepare next round
-			p.erase(v);
-			x.insert(v);
-		}
-	}
-
-	return result;
-}
-
-class TBBBKHelper {
+// pulls top-level vertices (heaviest first) until all of them are taken or the deadline is reached
+class TBBBKWorker {
 	public:
-		std::list<std::vector<std::size_t>> result;
-
-		TBBBKHelper(cs_workdata_t _data, cs_progress_t _progress) :
-			data(_data),
-			progress(_progress) {}
-
-		TBBBKHelper(TBBBKHelper& obj, tbb::split) :
-			data(obj.data),
-			progress(obj.progress) {}
-
-		void operator()(const tbb::blocked_range<std::size_t>& range) {
-			for (auto v = range.begin(); v != range.end(); ++v) {
-				auto& neighbors = (*data)[v];
-
-				// split neighbors
-				auto splitPoint = std::find_if(neighbors.begin(), neighbors.end(), [v](std::size_t i){return i>v;});
-				std::set<std::size_t> p(splitPoint, neighbors.end());
-				std::set<std::size_t> x(neighbors.begin(), splitPoint);
+		TBBBKWorker(const std::vector<std::size_t>* _order, cs_engines_t* _engines, cs_progress_t _next, cs_progress_t _progress, CliqueCancellation* _cancellation) :
+			order(_order),
+			engines(_engines),
+			next(_next),
+			progress(_progress),
+			cancellation(_cancellation) {}
+
+		void operator()() const {
+			auto& engine = engines->local();
+
+			while (true) {
+				// running vertices check the deadline themselves and get aborted
+				if (cancellation && cancellation->expired()) {
+					break;
+				}
 
-				// prepare r
-				std::vector<std::size_t> r({v});
+				std::size_t i = (*next)++;
+				if (i >= order->size()) {
+					break;
+				}
 
-				// shoot and merge
-				result.splice(result.end(), bronKerboschPivot(move(p), move(r), move(x), data));
+				// shoot
+				engine.search((*order)[i]);
 
 				// report progress
 				std::size_t pr = (*this->progress)++;
@@ -121,25 +57,80 @@ class TBBBKHelper {
 			}
 		}
 
-		void join(TBBBKHelper& obj) {
-			this->result.splice(this->result.end(), obj.result);
-		}
-
 	private:
-		cs_workdata_t data;
+		const std::vector<std::size_t>* order;
+		cs_engines_t* engines;
+		cs_progress_t next;
 		cs_progress_t progress;
+		CliqueCancellation* cancellation;
 };
 
-std::list<std::vector<std::size_t>> bronKerboschDegeneracy(std::shared_ptr<gc::Graph> data) {
+std::vector<std::size_t> scheduleVertices(const CSRGraph& data, const std::vector<std::size_t>* vertices) {
+	std::vector<std::size_t> order;
+	if (vertices) {
+		order = *vertices;
+	} else {
+		order.resize(data.getSize());
+		for (std::size_t v = 0; v < order.size(); ++v) {
+			order[v] = v;
+		}
+	}
+
+	// estimate cost by the number of larger neighbors (= size of P) and the total number of neighbors
+	std::vector<std::pair<std::size_t, std::size_t>> cost(data.getSize());
+	for (auto v : order) {
+		auto neighbors = data.get(v);
+		auto splitPoint = std::upper_bound(neighbors.begin(), neighbors.end(), v);
+		cost[v] = std::make_pair(static_cast<std::size_t>(neighbors.end() - splitPoint), neighbors.size());
+	}
+
+	std::stable_sort(order.begin(), order.end(), [&cost](std::size_t a, std::size_t b) {
+				return cost[a] > cost[b];
+			});
+
+	return order;
+}
+
+std::vector<std::size_t> bronKerboschDegeneracy(const CSRGraph& data, CliqueSink& sink, std::size_t minSize, const std::vector<std::size_t>* vertices, double timeBudget) {
 	std::cout << "Search cliques: " << std::flush;
-	std::unique_ptr<cs_workdataobj_t> workdata(createWorkdata(data));
+	std::vector<std::size_t> order = scheduleVertices(data, vertices);
+	std::unique_ptr<cs_progressobj_t> next(new cs_progressobj_t(0));
 	std::unique_ptr<cs_progressobj_t> progress(new cs_progressobj_t(0));
+	std::unique_ptr<cs_arenas_t> arenas(new cs_arenas_t());
+	tbb::task_group group;
 
-	TBBBKHelper helper(workdata.get(), progress.get());
-	parallel_reduce(tbb::blocked_range<std::size_t>(0, workdata->size()), helper);
+	// no new top-level vertices get started after the deadline, running ones get aborted
+	std::unique_ptr<CliqueCancellation> cancellation;
+	if (timeBudget > 0.0) {
+		cancellation.reset(new CliqueCancellation(std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(timeBudget))));
+	}
+
+	CliqueContext context = {&group, arenas.get(), &sink, CS_SPAWN_CUTOFF, minSize, cancellation.get()};
+	std::unique_ptr<cs_engines_t> engines(new cs_engines_t(CliqueEngine(&data, &context)));
 
-	std::cout << "done (found " << helper.result.size() << " cliques)" << std::endl;
+	// one worker per thread of the arena (= --threads), recursive branches get spawned into the same group
+	std::size_t nWorkers = static_cast<std::size_t>(std::max(1, tbb::this_task_arena::max_concurrency()));
+	for (std::size_t i = 0; i < nWorkers; ++i) {
+		group.run(TBBBKWorker(&order, engines.get(), next.get(), progress.get(), cancellation.get()));
+	}
+	group.wait();
+
+	// everything behind the last taken vertex is still unexplored, plus the vertices that were aborted
+	std::vector<std::size_t> pending(order.begin() + static_cast<std::ptrdiff_t>(std::min(next->load(), order.size())), order.end());
+	if (cancellation) {
+		const auto& aborted = cancellation->getAborted();
+		pending.insert(pending.end(), aborted.begin(), aborted.end());
+	}
+
+	std::cout << "done (found " << sink.getCount() << " cliques";
+	if (!pending.empty()) {
+		std::cout << ", time budget exceeded, " << pending.size() << " vertices pending";
+		if (pending.size() == order.size()) {
+			std::cout << ", no vertex finished, the budget is too small";
+		}
+	}
+	std::cout << ")" << std::endl;
 
-	return helper.result;
+	return pending;
 }
 
@@ -1,14 +1,17 @@
 #ifndef CLIQUESEARCHER_HPP
 #define CLIQUESEARCHER_HPP
 
-#include <list>
-#include <memory>
 #include <vector>
 
-#include "greycore/wrapper/graph.hpp"
+#include "cliquestore.hpp"
+#include "csrgraph.hpp"
 #include "sys.hpp"
 
-std::list<std::vector<std::size_t>> bronKerboschDegeneracy(std::shared_ptr<greycore::Graph> data);
+// Pushes all maximal cliques of data with at least minSize members into sink. Only cliques starting at the given
+// top-level vertices are searched (all vertices if nullptr). With timeBudget > 0 (seconds) the search stops when
+// the budget is used up: running top-level vertices get aborted and report none of their cliques. Returns the
+// top-level vertices that were not (completely) searched.
+std::vector<std::size_t> bronKerboschDegeneracy(const CSRGraph& data, CliqueSink& sink, std::size_t minSize, const std::vector<std::size_t>* vertices, double timeBudget);
 
 #endif
 
@@ -0,0 +1,232 @@
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <limits>
+#include <queue>
+#include <stdexcept>
+
+#include "cliquestore.hpp"
+
+constexpr std::size_t CliqueStore::bufferSize;
+
+// words that get read at once from one run during the merge
+constexpr std::size_t CS_MERGE_CHUNK = 1 << 14;
+
+// compares two flat cliques (size first, then lexicographic)
+inline bool cliqueLess(const CliqueStore::id_t* a, const CliqueStore::id_t* b) {
+	if (a[0] != b[0]) {
+		return a[0] < b[0];
+	}
+	return std::lexicographical_compare(a + 1, a + 1 + a[0], b + 1, b + 1 + b[0]);
+}
+
+// sequential reader for one sorted run, keeps at least one complete clique in memory
+class CliqueRunReader {
+	public:
+		CliqueRunReader(std::ifstream* _in, std::size_t _pos, std::size_t _end) :
+			in(_in),
+			pos(_pos),
+			end(_end),
+			buffer(),
+			current(0) {
+			fill();
+		}
+
+		bool empty() const {
+			return current >= buffer.size();
+		}
+
+		const CliqueStore::id_t* get() const {
+			return buffer.data() + current;
+		}
+
+		void next() {
+			current += buffer[current] + 1;
+			if ((current >= buffer.size()) || (current + buffer[current] + 1 > buffer.size())) {
+				fill();
+			}
+		}
+
+	private:
+		std::ifstream* in;
+		std::size_t pos;
+		std::size_t end;
+		std::vector<CliqueStore::id_t> buffer;
+		std::size_t current;
+
+		void fill() {
+			// keep rest of the buffer
+			buffer.erase(buffer.begin(), buffer.begin() + static_cast<std::ptrdiff_t>(std::min(current, buffer.size())));
+			current = 0;
+
+			// read chunks until the next clique is complete
+			do {
+				std::size_t n = std::min(CS_MERGE_CHUNK, end - pos);
+				if (n == 0) {
+					return;
+				}
+
+				std::size_t offset = buffer.size();
+				buffer.resize(offset + n);
+				in->seekg(static_cast<std::streamoff>(pos * sizeof(CliqueStore::id_t)));
+				in->read(reinterpret_cast<char*>(buffer.data() + offset), static_cast<std::streamsize>(n * sizeof(CliqueStore::id_t)));
+				if (!*in) {
+					throw std::runtime_error("Unable to read clique store");
+				}
+				pos += n;
+			} while (buffer[0] + 1 > buffer.size());
+		}
+};
+
+CliqueCounter::CliqueCounter() :
+	histograms(),
+	count(0) {}
+
+void CliqueCounter::push(const std::vector<std::size_t>& clique) {
+	auto& histogram = histograms.local();
+	if (histogram.size() <= clique.size()) {
+		histogram.resize(clique.size() + 1, 0);
+	}
+	++histogram[clique.size()];
+	++count;
+}
+
+std::size_t CliqueCounter::getCount() const {
+	return count;
+}
+
+std::vector<std::size_t> CliqueCounter::getHistogram() const {
+	std::vector<std::size_t> result;
+	for (const auto& histogram : histograms) {
+		if (result.size() < histogram.size()) {
+			result.resize(histogram.size(), 0);
+		}
+		for (std::size_t i = 0; i < histogram.size(); ++i) {
+			result[i] += histogram[i];
+		}
+	}
+	return result;
+}
+
+CliqueStore::CliqueStore(const std::string& _fname, const std::vector<std::size_t>& _idMap) :
+	fname(_fname),
+	idMap(_idMap),
+	buffers(),
+	count(0),
+	out(_fname, std::ios::binary | std::ios::trunc),
+	outPos(0),
+	runs(),
+	mutex() {
+	if (!out) {
+		throw std::runtime_error("Unable to open clique store: " + fname);
+	}
+}
+
+CliqueStore::~CliqueStore() {
+	out.close();
+	std::remove(fname.c_str());
+}
+
+void CliqueStore::push(const std::vector<std::size_t>& clique) {
+	auto& buffer = buffers.local();
+
+	// remap and sort, so the final ids get stored
+	std::size_t offset = buffer.data.size();
+	buffer.data.push_back(static_cast<id_t>(clique.size()));
+	for (auto d : clique) {
+		assert(idMap[d] <= std::numeric_limits<id_t>::max());
+		buffer.data.push_back(static_cast<id_t>(idMap[d]));
+	}
+	std::sort(buffer.data.begin() + static_cast<std::ptrdiff_t>(offset + 1), buffer.data.end());
+	++buffer.count;
+	++count;
+
+	if (buffer.data.size() >= bufferSize) {
+		writeRun(buffer);
+	}
+}
+
+std::size_t CliqueStore::getCount() const {
+	return count;
+}
+
+void CliqueStore::flush() {
+	for (auto& buffer : buffers) {
+		if (buffer.count > 0) {
+			writeRun(buffer);
+		}
+	}
+	out.flush();
+}
+
+void CliqueStore::writeRun(Buffer& buffer) {
+	// sort cliques of this buffer, using offsets into the flat list
+	std::vector<std::size_t> index;
+	index.reserve(buffer.count);
+	for (std::size_t i = 0; i < buffer.data.size(); i += buffer.data[i] + 1) {
+		index.push_back(i);
+	}
+	const id_t* base = buffer.data.data();
+	std::sort(index.begin(), index.end(), [base](std::size_t a, std::size_t b) {
+				return cliqueLess(base + a, base + b);
+			});
+
+	std::vector<id_t> sorted;
+	sorted.reserve(buffer.data.size());
+	for (auto i : index) {
+		sorted.insert(sorted.end(), base + i, base + i + base[i] + 1);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		out.write(reinterpret_cast<const char*>(sorted.data()), static_cast<std::streamsize>(sorted.size() * sizeof(id_t)));
+		if (!out) {
+			throw std::runtime_error("Unable to write clique store: " + fname);
+		}
+		runs.push_back(std::make_pair(outPos, sorted.size()));
+		outPos += sorted.size();
+	}
+
+	buffer.data.clear();
+	buffer.count = 0;
+}
+
+void CliqueStore::merge(std::function<void(const subspace_t&)> fun) {
+	std::ifstream in(fname, std::ios::binary);
+	if (!in) {
+		throw std::runtime_error("Unable to open clique store: " + fname);
+	}
+
+	std::vector<CliqueRunReader> readers;
+	readers.reserve(runs.size());
+	for (const auto& run : runs) {
+		readers.push_back(CliqueRunReader(&in, run.first, run.first + run.second));
+	}
+
+	// min-heap over the current head of every run
+	auto greater = [&readers](std::size_t a, std::size_t b) {
+		return cliqueLess(readers[b].get(), readers[a].get());
+	};
+	std::priority_queue<std::size_t, std::vector<std::size_t>, decltype(greater)> heap(greater);
+	for (std::size_t i = 0; i < readers.size(); ++i) {
+		if (!readers[i].empty()) {
+			heap.push(i);
+		}
+	}
+
+	subspace_t ss;
+	while (!heap.empty()) {
+		std::size_t i = heap.top();
+		heap.pop();
+
+		const id_t* clique = readers[i].get();
+		ss.assign(clique + 1, clique + 1 + clique[0]);
+		fun(ss);
+
+		readers[i].next();
+		if (!readers[i].empty()) {
+			heap.push(i);
+		}
+	}
+}
+
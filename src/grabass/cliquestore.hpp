@@ -0,0 +1,87 @@
+#ifndef CLIQUESTORE_HPP
+#define CLIQUESTORE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <tbb/enumerable_thread_specific.h>
+
+#include "sys.hpp"
+
+// receives every found clique, push has to be thread-safe
+class CliqueSink {
+	public:
+		virtual ~CliqueSink() {}
+
+		virtual void push(const std::vector<std::size_t>& clique) = 0;
+		virtual std::size_t getCount() const = 0;
+};
+
+// only counts cliques per size, without storing them
+class CliqueCounter : public CliqueSink {
+	public:
+		CliqueCounter();
+
+		void push(const std::vector<std::size_t>& clique) override;
+		std::size_t getCount() const override;
+
+		// number of cliques per size (index = size)
+		std::vector<std::size_t> getHistogram() const;
+
+	private:
+		tbb::enumerable_thread_specific<std::vector<std::size_t>> histograms;
+		std::atomic<std::size_t> count;
+};
+
+// Stores cliques on disk: every thread collects remapped + sorted cliques in a buffer, sorts it when it is full
+// and appends it as one sorted run to a scratch file. The final order (size, then lexicographic) gets produced
+// by a k-way merge over all runs.
+class CliqueStore : public CliqueSink {
+	public:
+		typedef std::uint32_t id_t;
+
+		CliqueStore(const std::string& fname, const std::vector<std::size_t>& idMap);
+		~CliqueStore();
+
+		void push(const std::vector<std::size_t>& clique) override;
+		std::size_t getCount() const override;
+
+		// write all remaining buffers, has to be called after the search is done
+		void flush();
+
+		// call fun for all cliques, in final order
+		void merge(std::function<void(const subspace_t&)> fun);
+
+	private:
+		// flat list of cliques: size, id1, id2, ...
+		struct Buffer {
+			std::vector<id_t> data;
+			std::size_t count;
+
+			Buffer() : data(), count(0) {}
+		};
+
+		static constexpr std::size_t bufferSize = 1 << 20;
+
+		std::string fname;
+		const std::vector<std::size_t>& idMap;
+		tbb::enumerable_thread_specific<Buffer> buffers;
+		std::atomic<std::size_t> count;
+
+		// runs (offset in words, size in words), guarded by mutex
+		std::ofstream out;
+		std::size_t outPos;
+		std::vector<std::pair<std::size_t, std::size_t>> runs;
+		std::mutex mutex;
+
+		void writeRun(Buffer& buffer);
+};
+
+#endif
+
@@ -1,26 +1,23 @@
+#include <algorithm>
+#include <atomic>
+#include <cassert>
 #include <iostream>
+#include <iterator>
 #include <limits>
-#include <unordered_set>
 #include <utility>
 #include <vector>
 
-#include "graphtransformation.hpp"
-
-namespace gc = greycore;
+#include <tbb/blocked_range.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_reduce.h>
 
-bool checkBidir(std::shared_ptr<gc::Graph> graph) {
-	for (std::size_t v = 0; v < graph->getSize(); ++v) {
-		for (auto w : graph->get(v)) {
-			bool ok = false;
-
-			for (auto z : graph->get(w)) {
-				if (v == z) {
-					ok = true;
-					break;
-				}
-			}
+#include "graphtransformation.hpp"
 
-			if (!ok) {
+bool checkBidir(const CSRGraph& graph) {
+	for (std::size_t v = 0; v < graph.getSize(); ++v) {
+		for (auto w : graph.get(v)) {
+			auto reverse = graph.get(w);
+			if (!std::binary_search(reverse.begin(), reverse.end(), v)) {
 				return false;
 			}
 		}
@@ -29,220 +26,657 @@ bool checkBidir(std::shared_ptr<gc::Graph> graph) {
 	return true;
 }
 
-inline double getConnectionRate(const std::vector<std::unordered_set<std::size_t>>& data, std::size_t v, std::size_t w) {
+typedef tbb::enumerable_thread_specific<std::vector<char>> markers_t;
+
+inline std::size_t countIntersection(const std::size_t* aBegin, const std::size_t* aEnd, const std::size_t* bBegin, const std::size_t* bEnd) {
 	std::size_t count = 0;
-	auto neighbors = data.at(v);
 
-	for (auto x : neighbors) {
-		auto& tmp = data.at(x);
-		if (tmp.find(w) != tmp.end()) {
-			++count;
+	// always search the smaller set inside the bigger one
+	if ((aEnd - aBegin) > (bEnd - bBegin)) {
+		std::swap(aBegin, bBegin);
+		std::swap(aEnd, bEnd);
+	}
+
+	if ((aEnd - aBegin) * 32 < (bEnd - bBegin)) {
+		// galloping search
+		for (; (aBegin != aEnd) && (bBegin != bEnd); ++aBegin) {
+			std::ptrdiff_t step = 1;
+			const std::size_t* hi = bBegin;
+			while ((hi != bEnd) && (*hi < *aBegin)) {
+				bBegin = hi + 1;
+				hi = (bEnd - bBegin > step) ? (bBegin + step) : bEnd;
+				step *= 2;
+			}
+			bBegin = std::lower_bound(bBegin, hi, *aBegin);
+			if ((bBegin != bEnd) && (*bBegin == *aBegin)) {
+				++count;
+				++bBegin;
+			}
+		}
+	} else {
+		// linear merge
+		while ((aBegin != aEnd) && (bBegin != bEnd)) {
+			if (*aBegin < *bBegin) {
+				++aBegin;
+			} else if (*bBegin < *aBegin) {
+				++bBegin;
+			} else {
+				++count;
+				++aBegin;
+				++bBegin;
+			}
 		}
 	}
 
-	return static_cast<double>(count) / static_cast<double>(neighbors.size());
+	return count;
+}
+
+inline double getConnectionRate(std::size_t count, const CSRGraph& data, std::size_t v) {
+	return static_cast<double>(count) / static_cast<double>(data.get(v).size());
 }
 
-void bidirLookup(std::shared_ptr<gc::Graph> input, std::shared_ptr<gc::Graph> output, double threshold) {
-	assert(output->getSize() == 0);
-
-	// build lookup table
-	std::vector<std::unordered_set<std::size_t>> lookupTable(input->getSize());
-	for (std::size_t v = 0; v < input->getSize(); ++v) {
-		auto neighbors = input->get(v);
-		lookupTable[v].insert(neighbors.begin(), neighbors.end());
-	}
-
-	// build cache
-	std::vector<std::unordered_set<std::size_t>> cache(input->getSize());
-
-	// for all vertices
-	for (std::size_t v = 0; v < input->getSize(); ++v) {
-		auto neighbors = input->get(v);
-		auto& neighborsNew = cache[v];
-		neighborsNew.insert(neighbors.begin(), neighbors.end());
-		std::unordered_set<std::size_t> checked(neighbors.begin(), neighbors.end());
-
-		// for every neighbor
-		for (auto w : neighbors) {
-			// check every 2nd generation neighbor
-			for (auto x : input->get(w)) {
-				// a new neighbor?
-				if (neighborsNew.find(x) == neighborsNew.end()) {
-					// can we use the cache?
-					if (x < v) {
-						auto& cachePart = cache[x];
-						if (cachePart.find(v) != cachePart.end()) {
-							neighborsNew.insert(x);
+class TBBBidirHelper {
+	public:
+		TBBBidirHelper(const CSRGraph& _data, std::vector<std::vector<std::size_t>>& _upper, double _threshold, markers_t& _markers, std::atomic<std::size_t>& _progress) :
+			data(_data),
+			upper(_upper),
+			threshold(_threshold),
+			markers(_markers),
+			progress(_progress) {}
+
+		TBBBidirHelper(TBBBidirHelper& obj, tbb::split) :
+			data(obj.data),
+			upper(obj.upper),
+			threshold(obj.threshold),
+			markers(obj.markers),
+			progress(obj.progress) {}
+
+		void operator()(const tbb::blocked_range<std::size_t>& range) {
+			auto& marker = markers.local();
+			std::vector<std::size_t> touched;
+
+			for (auto v = range.begin(); v != range.end(); ++v) {
+				auto neighbors = data.get(v);
+				auto& result = upper[v];
+
+				// mark existing neighbors, they are never checked
+				marker[v] = 1;
+				touched.assign(neighbors.begin(), neighbors.end());
+				touched.push_back(v);
+				for (auto w : neighbors) {
+					marker[w] = 1;
+				}
+
+				// check every 2nd generation neighbor, pairs are only tested once (x > v)
+				for (auto w : neighbors) {
+					auto candidates = data.get(w);
+					for (auto x = std::upper_bound(candidates.begin(), candidates.end(), v); x != candidates.end(); ++x) {
+						if (!marker[*x]) {
+							marker[*x] = 1;
+							touched.push_back(*x);
+
+							auto neighborsX = data.get(*x);
+							std::size_t count = countIntersection(neighbors.begin(), neighbors.end(), neighborsX.begin(), neighborsX.end());
+							if ((getConnectionRate(count, data, v) >= threshold) && (getConnectionRate(count, data, *x) >= threshold)) {
+								result.push_back(*x);
+							}
 						}
-					} else {
-						// insert non equal, well connencted neighbors
-						if ((v != x) && (checked.find(x) == checked.end()) && (getConnectionRate(lookupTable, v, x) >= threshold) && (getConnectionRate(lookupTable, x, v) >= threshold)) {
-							neighborsNew.insert(x);
+					}
+				}
+
+				for (auto x : touched) {
+					marker[x] = 0;
+				}
+				std::sort(result.begin(), result.end());
+
+				// report progress
+				std::size_t pr = progress++;
+				if (pr % 1000 == 0) {
+					std::cout << pr << std::flush;
+				} else if (pr % 100 == 0) {
+					std::cout << "." << std::flush;
+				}
+			}
+		}
+
+		void join(TBBBidirHelper&) {}
+
+	private:
+		const CSRGraph& data;
+		std::vector<std::vector<std::size_t>>& upper;
+		double threshold;
+		markers_t& markers;
+		std::atomic<std::size_t>& progress;
+};
+
+void bidirLookup(const CSRGraph& data, CSRGraph& output, double threshold) {
+	assert(output.getSize() == 0);
+	assert(checkBidir(data));
+	std::size_t size = data.getSize();
+
+	// find new well connected neighbors x > v for all vertices v, in both directions
+	std::vector<std::vector<std::size_t>> upper(size);
+	markers_t markers(std::vector<char>(size, 0));
+	std::atomic<std::size_t> progress(0);
+	TBBBidirHelper helper(data, upper, threshold, markers, progress);
+	parallel_reduce(tbb::blocked_range<std::size_t>(0, size), helper);
+
+	// mirror new edges
+	std::vector<std::vector<std::size_t>> lower(size);
+	for (std::size_t v = 0; v < size; ++v) {
+		for (auto x : upper[v]) {
+			lower[x].push_back(v);
+		}
+	}
+
+	// write old neighbors + new neighbors
+	CSRBuilder builder;
+	std::vector<std::size_t> neighborsNew;
+	for (std::size_t v = 0; v < size; ++v) {
+		auto neighbors = data.get(v);
+		neighborsNew.clear();
+		std::set_union(neighbors.begin(), neighbors.end(), upper[v].begin(), upper[v].end(), std::back_inserter(neighborsNew));
+		neighborsNew.insert(neighborsNew.end(), lower[v].begin(), lower[v].end());
+		std::inplace_merge(neighborsNew.begin(), neighborsNew.end() - static_cast<std::ptrdiff_t>(lower[v].size()), neighborsNew.end());
+
+		builder.add(neighborsNew.begin(), neighborsNew.end());
+		std::vector<std::size_t>().swap(upper[v]);
+		std::vector<std::size_t>().swap(lower[v]);
+	}
+	output = builder.finish();
+}
+
+class TBBExpandHelper {
+	public:
+		TBBExpandHelper(const CSRGraph& _current, const CSRGraph& _joined, std::vector<std::vector<std::size_t>>& _rowsNext, std::vector<std::vector<std::size_t>>& _rowsJoined, std::size_t _base, markers_t& _markers) :
+			current(_current),
+			joined(_joined),
+			rowsNext(_rowsNext),
+			rowsJoined(_rowsJoined),
+			base(_base),
+			markers(_markers) {}
+
+		TBBExpandHelper(TBBExpandHelper& obj, tbb::split) :
+			current(obj.current),
+			joined(obj.joined),
+			rowsNext(obj.rowsNext),
+			rowsJoined(obj.rowsJoined),
+			base(obj.base),
+			markers(obj.markers) {}
+
+		void operator()(const tbb::blocked_range<std::size_t>& range) {
+			// dense accumulator, reset after every row
+			auto& marker = markers.local();
+
+			for (auto v = range.begin(); v != range.end(); ++v) {
+				auto& next = rowsNext[v - base];
+				next.clear();
+
+				// boolean row product: union of all neighbors of neighbors
+				for (auto w : current.get(v)) {
+					for (auto x : current.get(w)) {
+						if (!marker[x]) {
+							marker[x] = 1;
+							next.push_back(x);
 						}
-						checked.insert(x);
 					}
 				}
+				for (auto x : next) {
+					marker[x] = 0;
+				}
+				std::sort(next.begin(), next.end());
+
+				// join with all former steps
+				auto joinedOld = joined.get(v);
+				auto& row = rowsJoined[v - base];
+				row.clear();
+				std::set_union(next.begin(), next.end(), joinedOld.begin(), joinedOld.end(), std::back_inserter(row));
 			}
 		}
 
-		std::list<std::size_t> l(neighborsNew.begin(), neighborsNew.end());
-		output->add(std::move(l));
+		void join(TBBExpandHelper&) {}
+
+	private:
+		const CSRGraph& current;
+		const CSRGraph& joined;
+		std::vector<std::vector<std::size_t>>& rowsNext;
+		std::vector<std::vector<std::size_t>>& rowsJoined;
+		std::size_t base;
+		markers_t& markers;
+};
+
+void expandNeighbors(const CSRGraph& input, CSRGraph& output, std::size_t dist) {
+	assert(output.getSize() == 0);
+	assert(dist > 1);
+
+	constexpr std::size_t chunkSize = 4096;
+	std::size_t size = input.getSize();
+	CSRGraph current = input;
+	CSRGraph joined = input;
+	markers_t markers(std::vector<char>(size, 0));
+
+	// every step squares the current graph (A_i = A_{i-1} * A_{i-1}) and joins it with all former steps,
+	// but only the last joined graph gets written
+	for (std::size_t step = 2; step <= dist; ++step) {
+		bool last = (step == dist);
+		CSRBuilder next;
+		CSRBuilder joinedNext;
+		std::cout << "(" << step << ")" << std::flush;
+
+		// process chunks to bound the memory used for temporary rows
+		std::vector<std::vector<std::size_t>> rowsNext(chunkSize);
+		std::vector<std::vector<std::size_t>> rowsJoined(chunkSize);
+		for (std::size_t base = 0; base < size; base += chunkSize) {
+			std::size_t end = std::min(size, base + chunkSize);
+			TBBExpandHelper helper(current, joined, rowsNext, rowsJoined, base, markers);
+			parallel_reduce(tbb::blocked_range<std::size_t>(base, end), helper);
+
+			for (std::size_t v = base; v < end; ++v) {
+				auto& row = rowsJoined[v - base];
+
+				if (last) {
+					// remove self reference
+					auto self = std::lower_bound(row.begin(), row.end(), v);
+					if ((self != row.end()) && (*self == v)) {
+						row.erase(self);
+					}
+
+					joinedNext.add(row.begin(), row.end());
+				} else {
+					next.add(rowsNext[v - base].begin(), rowsNext[v - base].end());
+					joinedNext.add(row.begin(), row.end());
+				}
+			}
 
-		// report progress
-		if (v % 1000 == 0) {
-			std::cout << v << std::flush;
-		} else if (v % 100 == 0) {
+			// report progress
 			std::cout << "." << std::flush;
 		}
+
+		if (last) {
+			output = joinedNext.finish();
+		} else {
+			current = next.finish();
+			joined = joinedNext.finish();
+		}
 	}
 }
 
-void lookupNeighbors(std::shared_ptr<gc::Graph> input, std::shared_ptr<gc::Graph> output) {
-	assert(output->getSize() == 0);
+std::vector<std::size_t> pruneCore(const CSRGraph& input, CSRGraph& output, std::size_t k) {
+	assert(output.getSize() == 0);
+	std::cout << "Prune graph (k=" << k << "): " << std::flush;
+	std::size_t size = input.getSize();
 
-	for (std::size_t v = 0; v < input->getSize(); ++v) {
-		std::unordered_set<std::size_t> neighborsNew;
+	// degree array (ignore self references), queue all vertices below k
+	std::vector<std::size_t> degree(size);
+	std::vector<char> removed(size, 0);
+	std::vector<std::size_t> queue;
+	for (std::size_t v = 0; v < size; ++v) {
+		auto neighbors = input.get(v);
+		degree[v] = neighbors.size() - (std::binary_search(neighbors.begin(), neighbors.end(), v) ? 1 : 0);
+		if (degree[v] < k) {
+			removed[v] = 1;
+			queue.push_back(v);
+		}
+	}
 
-		for (auto w : input->get(v)) {
-			auto tmp = input->get(w);
-			neighborsNew.insert(tmp.begin(), tmp.end());
+	// peel vertices, removals can push neighbors below k
+	while (!queue.empty()) {
+		std::size_t v = queue.back();
+		queue.pop_back();
+
+		for (auto u : input.get(v)) {
+			if (!removed[u]) {
+				--degree[u];
+				if (degree[u] < k) {
+					removed[u] = 1;
+					queue.push_back(u);
+				}
+			}
 		}
+	}
 
-		std::list<std::size_t> l(neighborsNew.begin(), neighborsNew.end());
-		output->add(std::move(l));
+	// remaining vertices (new id => old id) and reverse mapping
+	std::vector<std::size_t> keep;
+	std::vector<std::size_t> newIds(size, 0);
+	for (std::size_t v = 0; v < size; ++v) {
+		if (!removed[v]) {
+			newIds[v] = keep.size();
+			keep.push_back(v);
+		}
+	}
 
-		// report progress
-		if (v % 1000 == 0) {
-			std::cout << v << std::flush;
-		} else if (v % 100 == 0) {
-			std::cout << "." << std::flush;
+	// mapping is monotone, so rows stay sorted
+	CSRBuilder builder;
+	std::vector<std::size_t> neighborsNew;
+	for (auto v : keep) {
+		neighborsNew.clear();
+		for (auto u : input.get(v)) {
+			if (!removed[u]) {
+				neighborsNew.push_back(newIds[u]);
+			}
+		}
+		builder.add(neighborsNew.begin(), neighborsNew.end());
+	}
+	output = builder.finish();
+
+	// done
+	std::cout << "done (kept " << keep.size() << " of " << size << " vertices)" << std::endl;
+
+	return keep;
+}
+
+typedef std::vector<std::atomic<std::size_t>> parents_t;
+
+// root lookup with path halving, concurrent calls are fine because parents only move towards the root
+inline std::size_t findRoot(parents_t& parents, std::size_t x) {
+	std::size_t p;
+	while ((p = parents[x].load()) != x) {
+		std::size_t gp = parents[p].load();
+		parents[x].compare_exchange_weak(p, gp);
+		x = gp;
+	}
+	return x;
+}
+
+// lock-free union, the bigger root always gets linked to the smaller one so no cycles can occur
+inline void unite(parents_t& parents, std::size_t a, std::size_t b) {
+	while (true) {
+		a = findRoot(parents, a);
+		b = findRoot(parents, b);
+		if (a == b) {
+			return;
+		}
+		if (a < b) {
+			std::swap(a, b);
+		}
+
+		std::size_t expected = a;
+		if (parents[a].compare_exchange_strong(expected, b)) {
+			return;
 		}
 	}
 }
 
-void joinEdges(std::vector<std::shared_ptr<gc::Graph>> input, std::shared_ptr<gc::Graph> output) {
-	assert(output->getSize() == 0);
-	assert(!input.empty());
+class TBBUnionHelper {
+	public:
+		TBBUnionHelper(const CSRGraph& _data, parents_t& _parents) :
+			data(_data),
+			parents(_parents) {}
+
+		TBBUnionHelper(TBBUnionHelper& obj, tbb::split) :
+			data(obj.data),
+			parents(obj.parents) {}
+
+		void operator()(const tbb::blocked_range<std::size_t>& range) {
+			for (auto v = range.begin(); v != range.end(); ++v) {
+				for (auto u : data.get(v)) {
+					if (u != v) {
+						unite(parents, v, u);
+					}
+				}
+			}
+		}
+
+		void join(TBBUnionHelper&) {}
+
+	private:
+		const CSRGraph& data;
+		parents_t& parents;
+};
 
-	std::size_t size = (*input.begin())->getSize();
+GraphComponents findComponents(const CSRGraph& input) {
+	std::cout << "Find components: " << std::flush;
+	std::size_t size = input.getSize();
+
+	// union find over all edges
+	parents_t parents(size);
 	for (std::size_t v = 0; v < size; ++v) {
-		std::unordered_set<std::size_t> neighborsNew;
+		parents[v].store(v);
+	}
+	TBBUnionHelper helper(input, parents);
+	parallel_reduce(tbb::blocked_range<std::size_t>(0, size), helper);
 
-		for (auto g : input) {
-			auto tmp = g->get(v);
-			neighborsNew.insert(tmp.begin(), tmp.end());
+	// component sizes
+	std::vector<std::size_t> roots(size);
+	std::vector<std::size_t> componentSize(size, 0);
+	for (std::size_t v = 0; v < size; ++v) {
+		roots[v] = findRoot(parents, v);
+		++componentSize[roots[v]];
+	}
+
+	// biggest components first
+	std::vector<std::size_t> order;
+	for (std::size_t v = 0; v < size; ++v) {
+		if (roots[v] == v) {
+			order.push_back(v);
 		}
+	}
+	std::stable_sort(order.begin(), order.end(), [&componentSize](std::size_t a, std::size_t b) {
+				return componentSize[a] > componentSize[b];
+			});
+
+	// counting sort of all vertices, members stay in ascending order
+	GraphComponents result;
+	result.offsets.resize(order.size() + 1, 0);
+	std::vector<std::size_t> cursor(size, 0);
+	for (std::size_t i = 0; i < order.size(); ++i) {
+		cursor[order[i]] = result.offsets[i];
+		result.offsets[i + 1] = result.offsets[i] + componentSize[order[i]];
+	}
+	result.members.resize(size);
+	for (std::size_t v = 0; v < size; ++v) {
+		result.members[cursor[roots[v]]++] = v;
+	}
 
-		// remove self reference
-		neighborsNew.erase(v);
+	std::cout << "done (" << result.getCount() << " components, biggest=" << (order.empty() ? 0 : componentSize[order[0]]) << ")" << std::endl;
 
-		std::list<std::size_t> l(neighborsNew.begin(), neighborsNew.end());
-		output->add(move(l));
+	return result;
+}
 
-		// report progress
-		if (v % 1000 == 0) {
-			std::cout << v << std::flush;
-		} else if (v % 100 == 0) {
-			std::cout << "." << std::flush;
+// degeneracy order of a whole graph, returns new id => old id and fills pos with old id => new id
+std::vector<std::size_t> degeneracyOrder(const CSRGraph& input, std::vector<std::size_t>& pos, std::size_t& maxNeighbors, std::size_t& d) {
+	std::size_t size = input.getSize();
+
+	// degree array (ignore self references) + maximum number of neighbors
+	std::vector<std::size_t> degree(size);
+	maxNeighbors = 0;
+	for (std::size_t v = 0; v < size; ++v) {
+		auto neighbors = input.get(v);
+		degree[v] = neighbors.size() - (std::binary_search(neighbors.begin(), neighbors.end(), v) ? 1 : 0);
+		maxNeighbors = std::max(maxNeighbors, degree[v]);
+	}
+
+	// bucket queue (Matula-Beck / Batagelj-Zaversnik):
+	// vert holds all vertices sorted by degree, binStart[d] points to the first vertex with degree d
+	// and pos[v] is the position of v inside vert
+	std::vector<std::size_t> binStart(maxNeighbors + 1, 0);
+	for (std::size_t v = 0; v < size; ++v) {
+		++binStart[degree[v]];
+	}
+	std::size_t start = 0;
+	for (std::size_t deg = 0; deg <= maxNeighbors; ++deg) {
+		std::size_t n = binStart[deg];
+		binStart[deg] = start;
+		start += n;
+	}
+	std::vector<std::size_t> vert(size);
+	pos.assign(size, 0);
+	for (std::size_t v = 0; v < size; ++v) {
+		pos[v] = binStart[degree[v]]++;
+		vert[pos[v]] = v;
+	}
+	for (std::size_t deg = maxNeighbors; deg > 0; --deg) {
+		binStart[deg] = binStart[deg - 1];
+	}
+	binStart[0] = 0;
+
+	// remove vertices in order of their current degree
+	d = 0;
+	for (std::size_t counter = 0; counter < size; ++counter) {
+		std::size_t element = vert[counter];
+		d = std::max(d, degree[element]);
+
+		for (auto u : input.get(element)) {
+			// move u one bin down (swap with first vertex of its bin), but only if it was not removed yet
+			if (degree[u] > degree[element]) {
+				std::size_t du = degree[u];
+				std::size_t pu = pos[u];
+				std::size_t pw = binStart[du];
+				std::size_t w = vert[pw];
+				if (u != w) {
+					pos[u] = pw;
+					vert[pu] = w;
+					pos[w] = pu;
+					vert[pw] = u;
+				}
+				++binStart[du];
+				--degree[u];
+			}
 		}
 	}
+
+	return vert;
 }
 
-struct vertex_t {
-	std::size_t id;
-	std::unordered_set<std::size_t> neighbors;
-};
+class TBBSortHelper {
+	public:
+		TBBSortHelper(const CSRGraph& _data, const GraphComponents& _components, const std::vector<std::size_t>& _localIds, const std::vector<std::size_t>& _edgeBase, std::vector<std::size_t>& _idMap, std::vector<std::size_t>& _offsets, std::vector<std::size_t>& _neighbors, std::atomic<std::size_t>& _progress) :
+			data(_data),
+			components(_components),
+			localIds(_localIds),
+			edgeBase(_edgeBase),
+			idMap(_idMap),
+			offsets(_offsets),
+			neighbors(_neighbors),
+			progress(_progress),
+			maxNeighbors(0),
+			d(0) {}
+
+		TBBSortHelper(TBBSortHelper& obj, tbb::split) :
+			data(obj.data),
+			components(obj.components),
+			localIds(obj.localIds),
+			edgeBase(obj.edgeBase),
+			idMap(obj.idMap),
+			offsets(obj.offsets),
+			neighbors(obj.neighbors),
+			progress(obj.progress),
+			maxNeighbors(0),
+			d(0) {}
+
+		void operator()(const tbb::blocked_range<std::size_t>& range) {
+			std::vector<std::size_t> pos;
+			std::vector<std::size_t> neighborsNew;
+
+			for (auto c = range.begin(); c != range.end(); ++c) {
+				// vertex ids of the output are the positions in the member list
+				std::size_t base = components.offsets[c];
+				std::size_t end = components.offsets[c + 1];
+				const std::size_t* members = components.members.data() + base;
+
+				// build local graph, members are sorted so rows stay sorted
+				CSRBuilder builder;
+				for (std::size_t i = 0; i < end - base; ++i) {
+					neighborsNew.clear();
+					for (auto u : data.get(members[i])) {
+						neighborsNew.push_back(localIds[u]);
+					}
+					builder.add(neighborsNew.begin(), neighborsNew.end());
+				}
+				CSRGraph local = builder.finish();
+
+				std::size_t maxNeighborsLocal;
+				std::size_t dLocal;
+				auto vert = degeneracyOrder(local, pos, maxNeighborsLocal, dLocal);
+				maxNeighbors = std::max(maxNeighbors, maxNeighborsLocal);
+				d = std::max(d, dLocal);
+
+				// write rows with new ids
+				std::size_t cursor = edgeBase[c];
+				for (std::size_t i = 0; i < vert.size(); ++i) {
+					std::size_t iOld = vert[i];
+					idMap[base + i] = members[iOld];
+
+					neighborsNew.clear();
+					for (auto neighbor : local.get(iOld)) {
+						if (neighbor != iOld) {
+							neighborsNew.push_back(base + pos[neighbor]);
+						}
+					}
+					std::sort(neighborsNew.begin(), neighborsNew.end());
 
-std::unordered_map<std::size_t, std::size_t> sortGraph(std::shared_ptr<gc::Graph> input, std::shared_ptr<gc::Graph> output) {
-	assert(output->getSize() == 0);
-	std::cout << "Sort graph: " << std::flush;
-	std::unordered_map<std::size_t, std::size_t> idMap;
-	std::unordered_map<std::size_t, std::size_t> idMapRev;
-
-	// detect maximum number of neighbors
-	std::size_t maxNeighbors = 0;
-	for (std::size_t i = 0; i < input->getSize(); ++i) {
-		maxNeighbors = std::max(maxNeighbors, input->get(i).size());
-	}
-
-	// build initial bins
-	std::vector<std::vector<vertex_t*>> bins(maxNeighbors + 1);
-	for (std::size_t i = 0; i < input->getSize(); ++i) {
-		std::list<std::size_t> tmp = input->get(i);
-
-		bins[tmp.size()].push_back(new vertex_t({
-				i,
-				std::unordered_set<std::size_t>(tmp.begin(), tmp.end())})
-			);
-	}
-	std::size_t binMarker = 0;
-
-	// iterate throw all bins
-	std::size_t counter = 0;
-	std::size_t d = std::numeric_limits<std::size_t>::max();
-	while (binMarker <= maxNeighbors) {
-		// check if current bin contains elements
-		if (bins[binMarker].empty()) {
-			++binMarker;
-			continue;
-		}
-
-		// get+remove first element from bin
-		auto iter = --bins[binMarker].end();
-		std::size_t element = (*iter)->id;
-		delete (*iter);
-		bins[binMarker].erase(iter);
-
-		// process element
-		idMap[element] =  counter;
-		idMapRev[counter] = element;
-		++counter;
-		d = (d == std::numeric_limits<std::size_t>::max()) ? binMarker : std::max(d, binMarker);
-		binMarker = std::max(static_cast<std::size_t>(1), binMarker) - 1;
-
-		// create new bins
-		std::vector<std::vector<vertex_t*>> binsNext(maxNeighbors + 1);
-		for (auto bin : bins) {
-			for (auto v : bin) {
-				// delete edges to current element
-				v->neighbors.erase(element);
-
-				// add to right bin
-				binsNext[v->neighbors.size()].push_back(v);
+					std::copy(neighborsNew.begin(), neighborsNew.end(), neighbors.begin() + static_cast<std::ptrdiff_t>(cursor));
+					cursor += neighborsNew.size();
+					offsets[base + i + 1] = cursor;
+				}
+
+				// report progress
+				std::size_t pr = ++progress;
+				if (pr % 1000 == 0) {
+					std::cout << pr << std::flush;
+				} else if (pr % 100 == 0) {
+					std::cout << "." << std::flush;
+				}
 			}
 		}
-		swap(bins, binsNext);
 
-		// report progress
-		if (counter % 1000 == 0) {
-			std::cout << counter << std::flush;
-		} else if (counter % 100 == 0) {
-			std::cout << "." << std::flush;
+		void join(TBBSortHelper& other) {
+			maxNeighbors = std::max(maxNeighbors, other.maxNeighbors);
+			d = std::max(d, other.d);
 		}
-	}
 
-	// write output
-	for (std::size_t i = 0; i < input->getSize(); ++i) {
-		// lookup old element id
-		std::size_t iOld = idMapRev[i];
+		std::size_t getMaxNeighbors() const {
+			return maxNeighbors;
+		}
 
-		// lookup new neighbor ids
-		std::list<std::size_t> neighborsNew;
-		for (auto neighbor : input->get(iOld)) {
-			neighborsNew.push_back(idMap[neighbor]);
+		std::size_t getD() const {
+			return d;
 		}
 
-		// sort neighbors
-		neighborsNew.sort();
+	private:
+		const CSRGraph& data;
+		const GraphComponents& components;
+		const std::vector<std::size_t>& localIds;
+		const std::vector<std::size_t>& edgeBase;
+		std::vector<std::size_t>& idMap;
+		std::vector<std::size_t>& offsets;
+		std::vector<std::size_t>& neighbors;
+		std::atomic<std::size_t>& progress;
+		std::size_t maxNeighbors;
+		std::size_t d;
+};
 
-		// store new neighbors with new id
-		output->add(neighborsNew);
+std::vector<std::size_t> sortGraph(const CSRGraph& input, const GraphComponents& components, CSRGraph& output) {
+	assert(output.getSize() == 0);
+	std::cout << "Sort graph: " << std::flush;
+	std::size_t size = input.getSize();
+
+	// local id of every vertex inside of its component and first output edge of every component (self references get dropped)
+	std::vector<std::size_t> localIds(size);
+	std::vector<std::size_t> edgeBase(components.getCount() + 1, 0);
+	for (std::size_t c = 0; c < components.getCount(); ++c) {
+		std::size_t edges = 0;
+		for (std::size_t i = components.offsets[c]; i < components.offsets[c + 1]; ++i) {
+			std::size_t v = components.members[i];
+			auto neighbors = input.get(v);
+			localIds[v] = i - components.offsets[c];
+			edges += neighbors.size() - (std::binary_search(neighbors.begin(), neighbors.end(), v) ? 1 : 0);
+		}
+		edgeBase[c + 1] = edgeBase[c] + edges;
 	}
 
+	// order every component on its own, output is the concatenation of all sorted components
+	std::vector<std::size_t> idMap(size);
+	std::vector<std::size_t> offsets(size + 1, 0);
+	std::vector<std::size_t> neighbors(edgeBase.back());
+	std::atomic<std::size_t> progress(0);
+	TBBSortHelper helper(input, components, localIds, edgeBase, idMap, offsets, neighbors, progress);
+	parallel_reduce(tbb::blocked_range<std::size_t>(0, components.getCount(), 1), helper);
+	output = CSRGraph(std::move(offsets), std::move(neighbors));
+
 	// done
-	std::cout << "done (maxNeighbors=" << maxNeighbors << ", d=" << d << ")" << std::endl;
+	std::cout << "done (maxNeighbors=" << helper.getMaxNeighbors() << ", d=" << helper.getD() << ")" << std::endl;
 
-	return idMapRev;
+	return idMap;
 }
 
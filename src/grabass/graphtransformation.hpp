@@ -1,17 +1,26 @@
 #ifndef GRAPHTRANSFORMATION_HPP
 #define GRAPHTRANSFORMATION_HPP
 
-#include <memory>
-#include <unordered_map>
 #include <vector>
 
-#include "greycore/wrapper/graph.hpp"
+#include "csrgraph.hpp"
 #include "sys.hpp"
 
-void bidirLookup(std::shared_ptr<greycore::Graph> input, std::shared_ptr<greycore::Graph> output, double threshold);
-void lookupNeighbors(std::shared_ptr<greycore::Graph> input, std::shared_ptr<greycore::Graph> output);
-void joinEdges(std::vector<std::shared_ptr<greycore::Graph>> input, std::shared_ptr<greycore::Graph> output);
-std::unordered_map<std::size_t, std::size_t> sortGraph(std::shared_ptr<greycore::Graph> input, std::shared_ptr<greycore::Graph> output);
+// vertices grouped by connected component (biggest first), component i holds members[offsets[i]..offsets[i+1])
+struct GraphComponents {
+	std::vector<std::size_t> offsets;
+	std::vector<std::size_t> members;
+
+	std::size_t getCount() const {
+		return offsets.size() - 1;
+	}
+};
+
+void bidirLookup(const CSRGraph& input, CSRGraph& output, double threshold);
+void expandNeighbors(const CSRGraph& input, CSRGraph& output, std::size_t dist);
+std::vector<std::size_t> pruneCore(const CSRGraph& input, CSRGraph& output, std::size_t k);
+GraphComponents findComponents(const CSRGraph& input);
+std::vector<std::size_t> sortGraph(const CSRGraph& input, const GraphComponents& components, CSRGraph& output);
 
 #endif
 
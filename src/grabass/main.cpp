@@ -1,5 +1,7 @@
 #include <algorithm>
 #include <cassert>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
 #include <limits>
 #include <memory>
@@ -15,8 +17,11 @@
 #include "graphbuilder.hpp"
 #include "d1ops.hpp"
 #include "cliquesearcher.hpp"
+#include "cliquestore.hpp"
+#include "csrgraph.hpp"
 #include "tracer.hpp"
 #include "graphtransformation.hpp"
+#include "postfilter.hpp"
 #include "dimtransformation.hpp"
 
 #include "greycore/database.hpp"
@@ -37,7 +42,14 @@ int main(int argc, char **argv) {
 	bool cfgForce;
 	std::size_t cfgGraphDist;
 	std::size_t cfgThreads;
+	std::size_t cfgPartitionCache;
 	data_t cfgPostFilter;
+	std::string cfgCliqueStore;
+	std::size_t cfgMinSubspaceSize;
+	bool cfgCountOnly;
+	double cfgCliqueTimeBudget;
+	std::string cfgCliqueResume;
+	std::string cfgCliquePending;
 
 	// parse program options
 	po::options_description poDesc("Options");
@@ -82,6 +94,40 @@ int main(int argc, char **argv) {
 			po::value(&cfgPostFilter)->default_value(0.0, "0.0"),
 			"Entropy threshold for subspaces"
 		)
+		(
+			"minSubspaceSize",
+			po::value(&cfgMinSubspaceSize)->default_value(1),
+			"Minimal number of dimensions per subspace"
+		)
+		(
+			"countOnly",
+			"Only count found subspaces per size, do not write them"
+		)
+		(
+			"cliqueStore",
+			po::value(&cfgCliqueStore)->default_value("cliques.tmp"),
+			"Scratch file for found cliques"
+		)
+		(
+			"cliqueTimeBudget",
+			po::value(&cfgCliqueTimeBudget)->default_value(0.0, "0.0"),
+			"Time budget of the clique search in seconds, remaining vertices are written to cliquePending (0 = unlimited)"
+		)
+		(
+			"cliquePending",
+			po::value(&cfgCliquePending)->default_value("pending.txt"),
+			"Output file for vertices that were not searched because of the time budget"
+		)
+		(
+			"cliqueResume",
+			po::value(&cfgCliqueResume)->default_value(""),
+			"Only search the pending vertices of an earlier run (file written to cliquePending), needs a new output file"
+		)
+		(
+			"partitionCache",
+			po::value(&cfgPartitionCache)->default_value(256),
+			"Memory budget for cached row partitions of the post filter in MB"
+		)
 		(
 			"threads",
 			po::value(&cfgThreads)->default_value(0),
@@ -112,6 +158,15 @@ int main(int argc, char **argv) {
 		return EXIT_SUCCESS;
 	}
 	cfgForce = poVm.count("force");
+	cfgCountOnly = poVm.count("countOnly");
+
+	// a resumed run only writes the subspaces of the pending vertices, they have to be combined with the earlier result
+	if (!cfgCliqueResume.empty() && !cfgCountOnly && std::ifstream(cfgOutput)) {
+		std::cout << "Error:" << std::endl
+			<< "Output file " << cfgOutput << " already exists, a resumed run would overwrite the earlier result." << std::endl
+			<< "Use a different --output and combine both files afterwards." << std::endl;
+		return EXIT_FAILURE;
+	}
 
 	// setup tbb
 	int threads = static_cast<int>(cfgThreads);
@@ -133,12 +188,11 @@ int main(int argc, char **argv) {
 		auto tMain = std::make_shared<Tracer>("main", &timerProfile);
 		std::shared_ptr<Tracer> tPhase;
 
-		std::cout << "Open DB and output file: " << std::flush;
+		std::cout << "Open DB: " << std::flush;
 		tPhase.reset(new Tracer("open", tMain));
 		auto dbData = std::make_shared<gc::Database>(cfgDbData);
 		auto dbMetadata = std::make_shared<gc::Database>(cfgDbMetadata);
 		auto dbGraph = std::make_shared<gc::Database>(cfgDbGraph);
-		std::ofstream outfile(cfgOutput);
 
 		auto dimNameList = dbData->getIndexDims();
 		std::vector<datadim_t> dims;
@@ -231,128 +285,170 @@ int main(int argc, char **argv) {
 		dbMetadata.reset();
 		std::cout << "done" << std::endl;
 
+		// convert graph
+		std::cout << "Convert graph: " << std::flush;
+		tPhase.reset(new Tracer("convertGraph", tMain));
+		CSRGraph csrGraph(graph);
+		graph.reset();
+		std::cout << "done (" << csrGraph.getEdgeCount() << " entries)" << std::endl;
+
 		// calc distance graph
 		if (cfgGraphDist > 1) {
 			tPhase.reset(new Tracer("calcDistGraph", tMain));
-			std::vector<std::shared_ptr<gc::Graph>> distGraphSteps({graph});
-			auto last = graph;
-
-			for (std::size_t i = 2; i <= cfgGraphDist; ++i) {
-				std::cout << "Calc graph distance " << i << ": " << std::flush;
-				std::stringstream ss;
-				ss << "dist" << i;
-				auto next = std::make_shared<gc::Graph>(dbGraph->createDim<std::size_t>(ss.str() + ".1"), dbGraph->createDim<std::size_t>(ss.str() + ".2"));
-
-				if (cfgThresholdGraph == 0.0) {
-					lookupNeighbors(last, next);
-				} else {
-					bidirLookup(last, next, cfgThresholdGraph);
-				}
-
-				distGraphSteps.push_back(next);
-				last = next;
-				std::cout << "done" << std::endl;
-			}
 
 			if (cfgThresholdGraph == 0.0) {
-				std::cout << "Join graphs: " << std::flush;
-				auto distGraph = std::make_shared<gc::Graph>(dbGraph->createDim<std::size_t>("distGraph.1"), dbGraph->createDim<std::size_t>("distGraph.2"));
-				joinEdges(distGraphSteps, distGraph);
-				graph = distGraph;
+				std::cout << "Calc distance graph: " << std::flush;
+				CSRGraph distGraph;
+				expandNeighbors(csrGraph, distGraph, cfgGraphDist);
+				distGraph.store(dbGraph, "distGraph");
+				csrGraph = std::move(distGraph);
 				std::cout << "done" << std::endl;
 			} else {
-				graph = distGraphSteps.back();
+				for (std::size_t i = 2; i <= cfgGraphDist; ++i) {
+					std::cout << "Calc graph distance " << i << ": " << std::flush;
+					std::stringstream ss;
+					ss << "dist" << i;
+					CSRGraph next;
+					bidirLookup(csrGraph, next, cfgThresholdGraph);
+					next.store(dbGraph, ss.str());
+					csrGraph = std::move(next);
+					std::cout << "done" << std::endl;
+				}
 			}
 		}
 
+		// drop all vertices that cannot be part of a clique with cfgMinSubspaceSize members
+		std::vector<std::size_t> coreMap;
+		if (cfgMinSubspaceSize > 1) {
+			tPhase.reset(new Tracer("pruneGraph", tMain));
+			CSRGraph pruned;
+			coreMap = pruneCore(csrGraph, pruned, cfgMinSubspaceSize - 1);
+			csrGraph = std::move(pruned);
+		}
+
+		// split into connected components, they get ordered independently
+		tPhase.reset(new Tracer("findComponents", tMain));
+		auto components = findComponents(csrGraph);
+
 		// sort graph
 		tPhase.reset(new Tracer("sortGraph", tMain));
-		auto sortedGraph = std::make_shared<gc::Graph>(dbGraph->createDim<std::size_t>("sorted.1"), dbGraph->createDim<std::size_t>("sorted.2"));
-		auto idMap = sortGraph(graph, sortedGraph);
+		CSRGraph sortedGraph;
+		auto idMap = sortGraph(csrGraph, components, sortedGraph);
+		sortedGraph.store(dbGraph, "sorted");
+		if (cfgMinSubspaceSize > 1) {
+			for (auto& id : idMap) {
+				id = coreMap[id];
+			}
+		}
+
+		// only continue with the pending vertices of an interrupted run
+		std::unique_ptr<std::vector<std::size_t>> resumeVertices;
+		if (!cfgCliqueResume.empty()) {
+			std::cout << "Load pending vertices: " << std::flush;
+			std::ifstream resumeFile(cfgCliqueResume);
+			if (!resumeFile) {
+				std::cout << "Error: unable to open " << cfgCliqueResume << std::endl;
+				return EXIT_FAILURE;
+			}
+
+			// pending vertices are stored as original ids, vertices that were pruned do not show up in idMap
+			std::vector<std::size_t> reverseMap(dims.size(), std::numeric_limits<std::size_t>::max());
+			for (std::size_t i = 0; i < idMap.size(); ++i) {
+				reverseMap[idMap[i]] = i;
+			}
+
+			resumeVertices.reset(new std::vector<std::size_t>());
+			std::size_t id;
+			while (resumeFile >> id) {
+				if ((id < reverseMap.size()) && (reverseMap[id] != std::numeric_limits<std::size_t>::max())) {
+					resumeVertices->push_back(reverseMap[id]);
+					reverseMap[id] = std::numeric_limits<std::size_t>::max();
+				}
+			}
+
+			std::cout << "done (" << resumeVertices->size() << " vertices)" << std::endl;
+		}
 
 		// search cliques
 		tPhase.reset(new Tracer("cliqueSearcher", tMain));
-		auto subspaces = bronKerboschDegeneracy(sortedGraph);
-
-		// lookup final subspace results from idMap
-		std::list<subspace_t> result;
-		std::transform(subspaces.begin(), subspaces.end(), std::back_inserter(result), [&idMap](const std::vector<std::size_t>& ss){
-					std::list<std::size_t> tmp;
-					std::transform(ss.begin(), ss.end(), std::back_inserter(tmp), [&idMap](std::size_t d) {
-							return idMap[d];
-						});
-					tmp.sort();
-					return tmp;
-				});
-		result.sort([](const subspace_t& a, const subspace_t& b){
-					if (a.size() != b.size()) {
-						return a.size() < b.size();
-					} else {
-						auto iter1 = a.cbegin();
-						auto iter2 = b.cbegin();
-						while ((iter1 != a.cend()) && (iter2 != b.cend())) {
-							if (*iter1 != *iter2) {
-								return *iter1 < *iter2;
-							}
-
-							++iter1;
-							++iter2;
+		std::vector<std::size_t> pending;
+		if (cfgCountOnly) {
+			CliqueCounter counter;
+			pending = bronKerboschDegeneracy(sortedGraph, counter, cfgMinSubspaceSize, resumeVertices.get(), cfgCliqueTimeBudget);
+
+			std::cout << "Clique sizes:" << std::endl;
+			auto histogram = counter.getHistogram();
+			for (std::size_t size = 0; size < histogram.size(); ++size) {
+				if (histogram[size] > 0) {
+					std::cout << "  " << size << ": " << histogram[size] << std::endl;
+				}
+			}
+		} else {
+			CliqueStore store(cfgCliqueStore, idMap);
+			pending = bronKerboschDegeneracy(sortedGraph, store, cfgMinSubspaceSize, resumeVertices.get(), cfgCliqueTimeBudget);
+			store.flush();
+
+			// merge sorted cliques, filter and write them
+			tPhase.reset(new Tracer("output", tMain));
+			std::cout << "Filter and write subspaces: " << std::flush;
+			std::ofstream outfile(cfgOutput); // only here, a count only run must not truncate an earlier result
+			std::size_t nWritten = 0;
+			auto writeSubspace = [&outfile, &nWritten](const subspace_t& ss) {
+					bool first = true;
+					for (auto dim : ss) {
+						if (first) {
+							first = false;
+						} else {
+							outfile << ",";
 						}
-						return true;
+						outfile << dim;
 					}
-				});
+					outfile << "\n";
+					++nWritten;
+				};
+
+			if (cfgPostFilter > 0) {
+				std::vector<discretedim_t> dimVector;
+				std::transform(discreteDims.begin(), discreteDims.end(), std::back_inserter(dimVector), [](std::pair<discretedim_t, discretedim_t>& p) {
+						return p.first;
+						});
+				std::vector<std::size_t> binCounts = calcBinCounts(dimVector);
+				EntropyEngine entropyEngine(dimVector, binCounts, cfgPartitionCache << 20);
 
-		// post filter
-		tPhase.reset(new Tracer("postFilter", tMain));
-		std::cout << "Filter subspaces: " << std::flush;
-		if (cfgPostFilter > 0) {
-			decltype(result) tmp;
-			std::swap(result, tmp);
-			data_t entropyMin = std::numeric_limits<data_t>::infinity();
-			data_t entropyMax = 0;
-			std::size_t nDrops = 0;
-
-			std::vector<discretedim_t> dimVector;
-			std::transform(discreteDims.begin(), discreteDims.end(), std::back_inserter(dimVector), [](std::pair<discretedim_t, discretedim_t>& p) {
-					return p.first;
+				PostFilter filter(&entropyEngine, cfgPostFilter, writeSubspace);
+				store.merge([&filter](const subspace_t& ss) {
+						filter.push(ss);
 					});
+				filter.flush();
 
-			for (const auto& ss : tmp) {
-				data_t entropy = calcEntropy(ss, dimVector);
-				entropyMin = std::min(entropyMin, entropy);
-				entropyMax = std::max(entropyMax, entropy);
-
-				if (entropy > cfgPostFilter) {
-					result.push_back(ss);
-				} else {
-					++nDrops;
-				}
+				std::cout << "done (written=" << nWritten << ", entropMin=" << filter.getEntropyMin() << ", entropyMax=" << filter.getEntropyMax() << ", dropped=" << filter.getDrops() << ")" << std::endl;
+			} else {
+				store.merge(writeSubspace);
 
-				// progress
-				std::cout << "." << std::flush;
+				std::cout << "done (written=" << nWritten << ")" << std::endl;
 			}
-
-			std::cout << "done (entropMin=" << entropyMin << ", entropyMax=" << entropyMax << ", dropped=" << nDrops << ")" << std::endl;
-		} else {
-			std::cout << "skipped" << std::endl;
+			outfile.flush();
 		}
 
-		// ok, so lets write the results
-		tPhase.reset(new Tracer("output", tMain));
-		std::cout << "Write result: " << std::flush;
-		for (auto ss : result) {
-			bool first = true;
-			for (auto dim : ss) {
-				if (first) {
-					first = false;
-				} else {
-					outfile << ",";
-				}
-				outfile << dim;
+		// remember unexplored vertices, so a later run can resume the search
+		if (!pending.empty()) {
+			std::cout << "Write pending vertices: " << std::flush;
+			std::vector<std::size_t> pendingIds;
+			std::transform(pending.begin(), pending.end(), std::back_inserter(pendingIds), [&idMap](std::size_t v) {
+					return idMap[v];
+				});
+			std::sort(pendingIds.begin(), pendingIds.end());
+
+			std::ofstream pendingFile(cfgCliquePending);
+			for (auto id : pendingIds) {
+				pendingFile << id << std::endl;
 			}
-			outfile << std::endl;
+			std::cout << "done (" << pendingIds.size() << " vertices, resume with --cliqueResume " << cfgCliquePending << " and a new --output)" << std::endl;
+		} else {
+			// drop the list of an earlier run, so nothing gets resumed twice
+			std::remove(cfgCliquePending.c_str());
+			std::cout << "Clique search complete, no vertices pending" << std::endl;
 		}
-		std::cout << "done" << std::endl;
 
 		std::cout << "Cleanup and Sync: " << std::flush;
 		// end of block => free dims and db
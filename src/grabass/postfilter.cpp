@@ -0,0 +1,99 @@
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_reduce.h>
+
+#include "postfilter.hpp"
+
+constexpr std::size_t PostFilter::batchSize;
+
+class TBBPostFilterHelper {
+	public:
+		data_t entropyMin = std::numeric_limits<data_t>::infinity();
+		data_t entropyMax = 0;
+
+		TBBPostFilterHelper(EntropyEngine* _engine, const std::vector<subspace_t>& _batch, std::vector<data_t>& _entropies) :
+			engine(_engine),
+			batch(_batch),
+			entropies(_entropies) {}
+
+		TBBPostFilterHelper(TBBPostFilterHelper& obj, tbb::split) :
+			engine(obj.engine),
+			batch(obj.batch),
+			entropies(obj.entropies) {}
+
+		void operator()(const tbb::blocked_range<std::size_t>& range) {
+			for (auto i = range.begin(); i != range.end(); ++i) {
+				data_t entropy = engine->calcEntropy(batch[i]);
+				entropies[i] = entropy;
+				entropyMin = std::min(entropyMin, entropy);
+				entropyMax = std::max(entropyMax, entropy);
+			}
+		}
+
+		void join(TBBPostFilterHelper& obj) {
+			this->entropyMin = std::min(this->entropyMin, obj.entropyMin);
+			this->entropyMax = std::max(this->entropyMax, obj.entropyMax);
+		}
+
+	private:
+		EntropyEngine* engine;
+		const std::vector<subspace_t>& batch;
+		std::vector<data_t>& entropies;
+};
+
+PostFilter::PostFilter(EntropyEngine* _engine, data_t _threshold, std::function<void(const subspace_t&)> _output) :
+	engine(_engine),
+	threshold(_threshold),
+	output(_output),
+	batch(),
+	entropies(),
+	entropyMin(std::numeric_limits<data_t>::infinity()),
+	entropyMax(0),
+	nDrops(0),
+	nBatches(0) {
+	batch.reserve(batchSize);
+}
+
+void PostFilter::push(const subspace_t& subspace) {
+	batch.push_back(subspace);
+
+	if (batch.size() >= batchSize) {
+		runBatch();
+	}
+}
+
+void PostFilter::flush() {
+	if (!batch.empty()) {
+		runBatch();
+	}
+}
+
+void PostFilter::runBatch() {
+	entropies.resize(batch.size());
+	TBBPostFilterHelper helper(engine, batch, entropies);
+	parallel_reduce(tbb::blocked_range<std::size_t>(0, batch.size()), helper);
+	entropyMin = std::min(entropyMin, helper.entropyMin);
+	entropyMax = std::max(entropyMax, helper.entropyMax);
+
+	// keep order of the input
+	for (std::size_t i = 0; i < batch.size(); ++i) {
+		if (entropies[i] > threshold) {
+			output(batch[i]);
+		} else {
+			++nDrops;
+		}
+	}
+	batch.clear();
+
+	// report progress
+	++nBatches;
+	if (nBatches % 10 == 0) {
+		std::cout << (nBatches * batchSize) << std::flush;
+	} else {
+		std::cout << "." << std::flush;
+	}
+}
+
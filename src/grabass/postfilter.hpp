@@ -0,0 +1,52 @@
+#ifndef POSTFILTER_HPP
+#define POSTFILTER_HPP
+
+#include <functional>
+#include <vector>
+
+#include "entropy.hpp"
+#include "sys.hpp"
+
+// Drops all subspaces with an entropy <= threshold. Subspaces get collected into batches, the entropies of a
+// batch are calculated in parallel and the accepted subspaces are passed to output in their original order.
+class PostFilter {
+	public:
+		PostFilter(EntropyEngine* engine, data_t threshold, std::function<void(const subspace_t&)> output);
+
+		void push(const subspace_t& subspace);
+
+		// process the remaining subspaces, has to be called after the last push
+		void flush();
+
+		data_t getEntropyMin() const {
+			return entropyMin;
+		}
+
+		data_t getEntropyMax() const {
+			return entropyMax;
+		}
+
+		std::size_t getDrops() const {
+			return nDrops;
+		}
+
+	private:
+		static constexpr std::size_t batchSize = 1 << 14;
+
+		EntropyEngine* engine;
+		data_t threshold;
+		std::function<void(const subspace_t&)> output;
+
+		std::vector<subspace_t> batch;
+		std::vector<data_t> entropies;
+
+		data_t entropyMin;
+		data_t entropyMax;
+		std::size_t nDrops;
+		std::size_t nBatches;
+
+		void runBatch();
+};
+
+#endif
+
@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <limits>
+
+#include "kdtree.hpp"
+
+constexpr std::size_t KDTree::noChild;
+
+KDTree::KDTree(const Projection& _points, std::size_t _leafSize) :
+	points(_points),
+	leafSize(std::max(_leafSize, static_cast<std::size_t>(1))),
+	nDims(_points.getDims()),
+	margin(1 + 2 * static_cast<data_t>(nDims + 1) * std::numeric_limits<data_t>::epsilon()),
+	ids(_points.getSize()),
+	values(),
+	nodes(),
+	boxes() {
+	for (std::size_t i = 0; i < ids.size(); ++i) {
+		ids[i] = i;
+	}
+
+	if (!ids.empty()) {
+		build(0, ids.size());
+	}
+
+	// copy values into tree order, so leaves are scanned sequentially
+	values.resize(ids.size() * nDims);
+	for (std::size_t i = 0; i < ids.size(); ++i) {
+		const data_t* row = points.get(ids[i]);
+		std::copy(row, row + nDims, values.begin() + static_cast<std::ptrdiff_t>(i * nDims));
+	}
+}
+
+std::size_t KDTree::build(std::size_t begin, std::size_t end) {
+	std::size_t node = nodes.size();
+	nodes.push_back(Node{begin, end, noChild, noChild});
+
+	// bounding box
+	std::size_t boxOffset = boxes.size();
+	boxes.resize(boxOffset + 2 * nDims);
+	std::size_t splitDim = 0;
+	data_t splitSpread = 0;
+	for (std::size_t s = 0; s < nDims; ++s) {
+		data_t min = std::numeric_limits<data_t>::max();
+		data_t max = std::numeric_limits<data_t>::lowest();
+		for (std::size_t i = begin; i < end; ++i) {
+			data_t x = points.get(ids[i])[s];
+			min = std::min(min, x);
+			max = std::max(max, x);
+		}
+		boxes[boxOffset + 2 * s] = min;
+		boxes[boxOffset + 2 * s + 1] = max;
+
+		if (max - min > splitSpread) {
+			splitDim = s;
+			splitSpread = max - min;
+		}
+	}
+
+	// leaf: small enough or all points are equal
+	if ((end - begin <= leafSize) || (splitSpread <= 0)) {
+		return node;
+	}
+
+	std::size_t mid = begin + (end - begin) / 2;
+	std::nth_element(ids.begin() + static_cast<std::ptrdiff_t>(begin), ids.begin() + static_cast<std::ptrdiff_t>(mid), ids.begin() + static_cast<std::ptrdiff_t>(end), [this, splitDim](std::size_t a, std::size_t b){
+			return points.get(a)[splitDim] < points.get(b)[splitDim];
+		});
+
+	std::size_t left = build(begin, mid);
+	std::size_t right = build(mid, end);
+	nodes[node].left = left;
+	nodes[node].right = right;
+
+	return node;
+}
+
+// Lower bound for the squared distance of query to any point in the box. Every term is <= the corresponding term
+// of the real distance (also after rounding), but the sums may be rounded differently (-ffast-math may reorder
+// them), so searches compare it against the limit with the same margin as the brute-force abandoning.
+data_t KDTree::boxDist2(std::size_t node, const data_t* query) const {
+	const data_t* box = boxes.data() + node * 2 * nDims;
+	data_t sum = 0;
+
+	for (std::size_t s = 0; s < nDims; ++s) {
+		data_t delta = 0;
+		if (query[s] < box[2 * s]) {
+			delta = query[s] - box[2 * s];
+		} else if (query[s] > box[2 * s + 1]) {
+			delta = query[s] - box[2 * s + 1];
+		}
+		sum += delta * delta;
+	}
+
+	return sum;
+}
+
+void KDTree::search(std::size_t node, Search& s) const {
+	const Node& n = nodes[node];
+
+	if (n.left == noChild) {
+		for (std::size_t i = n.begin; i < n.end; ++i) {
+			if (ids[i] != s.obj) {
+				s.heap.add(ids[i], points.dist2(s.query, values.data() + i * nDims));
+			}
+		}
+		return;
+	}
+
+	// nearer child first, so the limit shrinks fast
+	data_t distLeft = boxDist2(n.left, s.query);
+	data_t distRight = boxDist2(n.right, s.query);
+	std::size_t first = n.left;
+	std::size_t second = n.right;
+	if (distRight < distLeft) {
+		std::swap(first, second);
+		std::swap(distLeft, distRight);
+	}
+
+	if (distLeft <= s.heap.getLimit() * margin) {
+		search(first, s);
+	}
+	if (distRight <= s.heap.getLimit() * margin) {
+		search(second, s);
+	}
+}
+
+void KDTree::query(std::size_t obj, std::size_t kMax, KnnHeap::neighbors_t& result) const {
+	Search s{points.get(obj), obj, KnnHeap(kMax, result)};
+	if (!nodes.empty() && (kMax > 0)) {
+		search(0, s);
+	}
+	s.heap.finish();
+}
+
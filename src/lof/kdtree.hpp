@@ -0,0 +1,56 @@
+#ifndef KDTREE_HPP
+#define KDTREE_HPP
+
+#include <tuple>
+#include <vector>
+
+#include "knnheap.hpp"
+#include "projection.hpp"
+
+// Exact kNN index for low dimensional projections. Every node splits its objects at the median of the dimension
+// with the biggest spread, leaves hold up to leafSize objects. Node boxes are tight bounding boxes, so a search
+// can skip every node that cannot contain a point within the current k-distance.
+class KDTree {
+	public:
+		KDTree(const Projection& points, std::size_t leafSize);
+
+		// kMax nearest neighbors of obj (without obj itself) and all ties of the kMax-th one, as (id, squared
+		// distance) in no particular order
+		void query(std::size_t obj, std::size_t kMax, KnnHeap::neighbors_t& result) const;
+
+	private:
+		static constexpr std::size_t noChild = static_cast<std::size_t>(-1);
+
+		struct Node {
+			std::size_t begin;
+			std::size_t end;
+			std::size_t left;
+			std::size_t right;
+		};
+
+		struct Search {
+			const data_t* query;
+			std::size_t obj;
+			KnnHeap heap;
+		};
+
+		const Projection& points;
+		std::size_t leafSize;
+		std::size_t nDims;
+
+		// relative error of the box bound and the distance is below (nDims + 1) * epsilon / 2 each
+		data_t margin;
+
+		// object ids and values in tree order, boxes as (min, max) pairs for all dims
+		std::vector<std::size_t> ids;
+		std::vector<data_t> values;
+		std::vector<Node> nodes;
+		std::vector<data_t> boxes;
+
+		std::size_t build(std::size_t begin, std::size_t end);
+		data_t boxDist2(std::size_t node, const data_t* query) const;
+		void search(std::size_t node, Search& s) const;
+};
+
+#endif
+
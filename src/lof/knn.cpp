@@ -0,0 +1,316 @@
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_reduce.h>
+
+#include "kdtree.hpp"
+#include "knn.hpp"
+#include "knnheap.hpp"
+#include "projection.hpp"
+
+// objects per KD-tree leaf
+constexpr std::size_t treeLeafSize = 16;
+
+// brute force: queries that share one tile of candidates, tile size so the tile columns stay in the cache
+constexpr std::size_t bruteQueries = 8;
+constexpr std::size_t bruteTileSize = 1024;
+
+// brute force with early abandoning: queries to compare its effort with the tiled kernel, it is used for the
+// remaining queries if it sums up at most 1/sweepMinSaving of the terms of the tiled kernel
+constexpr std::size_t sweepSample = 256;
+constexpr std::size_t sweepMinSaving = 5;
+
+// ties sorted by id, so the order does not depend on the search method
+bool byDistAndId(const std::tuple<std::size_t, data_t>& a, const std::tuple<std::size_t, data_t>& b) {
+	return (std::get<1>(a) < std::get<1>(b)) || ((std::get<1>(a) == std::get<1>(b)) && (std::get<0>(a) < std::get<0>(b)));
+}
+
+// neighbors with squared distances => sorted neighbors with distances, roots only for the selected ones
+void storeNeighbors(std::vector<std::tuple<std::size_t, data_t>>::iterator begin, std::vector<std::tuple<std::size_t, data_t>>::iterator end, std::vector<std::tuple<std::size_t, data_t>>& target) {
+	for (auto iter = begin; iter != end; ++iter) {
+		std::get<1>(*iter) = std::sqrt(std::get<1>(*iter));
+	}
+	std::sort(begin, end, byDistAndId);
+	target.assign(begin, end);
+}
+
+void reportProgress(std::atomic<std::size_t>& progress) {
+	std::size_t p = progress++;
+	if (p % 1000 == 0) {
+		std::cout << "+" << std::flush;
+	}
+}
+
+class TBBHelperBrute {
+	public:
+		TBBHelperBrute(distCache_t& _result, std::size_t _kMax, const Projection& _points, std::atomic<std::size_t>& _progress) :
+			result(_result),
+			kMax(_kMax),
+			points(_points),
+			progress(_progress) {}
+
+		TBBHelperBrute(TBBHelperBrute& obj, tbb::split) :
+			result(obj.result),
+			kMax(obj.kMax),
+			points(obj.points),
+			progress(obj.progress) {}
+
+		void operator()(const tbb::blocked_range<std::size_t>& range) {
+			std::size_t nObjs = points.getSize();
+			assert((kMax > 0) && (kMax < nObjs));
+
+			// squared distances of all queries of one block, one row per query
+			std::vector<data_t> rows(bruteQueries * nObjs);
+			std::vector<data_t> selection(nObjs - 1);
+			std::vector<std::tuple<std::size_t, data_t>> neighbors;
+
+			// level 1: blocks of query objects
+			for (std::size_t queryBegin = range.begin(); queryBegin < range.end(); queryBegin += bruteQueries) {
+				std::size_t queryEnd = std::min(queryBegin + bruteQueries, range.end());
+
+				// level 2: tiles of candidates, shared by all queries of the block
+				for (std::size_t tileBegin = 0; tileBegin < nObjs; tileBegin += bruteTileSize) {
+					std::size_t tileEnd = std::min(tileBegin + bruteTileSize, nObjs);
+
+					for (std::size_t obj1 = queryBegin; obj1 < queryEnd; ++obj1) {
+						data_t* row = rows.data() + (obj1 - queryBegin) * nObjs;
+						points.dist2Tile(points.get(obj1), tileBegin, tileEnd, row + tileBegin);
+					}
+				}
+
+				// kMax nearest neighbors + all ties of the kMax-th one, without sorting all distances
+				for (std::size_t obj1 = queryBegin; obj1 < queryEnd; ++obj1) {
+					const data_t* row = rows.data() + (obj1 - queryBegin) * nObjs;
+					std::copy(row, row + obj1, selection.begin());
+					std::copy(row + obj1 + 1, row + nObjs, selection.begin() + static_cast<std::ptrdiff_t>(obj1));
+
+					auto kth = selection.begin() + static_cast<std::ptrdiff_t>(kMax - 1);
+					std::nth_element(selection.begin(), kth, selection.end());
+					data_t limit = tieLimit(*kth);
+
+					neighbors.clear();
+					for (std::size_t obj2 = 0; obj2 < nObjs; ++obj2) {
+						if ((row[obj2] <= limit) && (obj1 != obj2)) {
+							neighbors.push_back(std::make_tuple(obj2, row[obj2]));
+						}
+					}
+					storeNeighbors(neighbors.begin(), neighbors.end(), result[obj1]);
+
+					reportProgress(progress);
+				}
+			}
+		}
+
+		void join(TBBHelperBrute&) {}
+
+	private:
+		distCache_t& result;
+		std::size_t kMax;
+		const Projection& points;
+		std::atomic<std::size_t>& progress;
+};
+
+// Objects ordered by the value of the dim with the biggest variance, all rows with the dims in variance order.
+struct SweepIndex {
+	std::vector<std::size_t> ids;
+	std::vector<std::size_t> positions;
+	std::vector<data_t> rows;
+
+	explicit SweepIndex(const Projection& points) :
+		ids(points.getSize()),
+		positions(points.getSize()),
+		rows() {
+		std::size_t nObjs = points.getSize();
+		std::size_t nDims = points.getDims();
+		auto order = points.getVarianceOrder();
+		auto byVariance = points.getRows(order);
+
+		for (std::size_t i = 0; i < nObjs; ++i) {
+			ids[i] = i;
+		}
+		std::stable_sort(ids.begin(), ids.end(), [&byVariance, nDims](std::size_t a, std::size_t b){
+				return byVariance[a * nDims] < byVariance[b * nDims];
+			});
+
+		rows.resize(nObjs * nDims);
+		for (std::size_t i = 0; i < nObjs; ++i) {
+			positions[ids[i]] = i;
+			std::copy(byVariance.begin() + static_cast<std::ptrdiff_t>(ids[i] * nDims), byVariance.begin() + static_cast<std::ptrdiff_t>((ids[i] + 1) * nDims), rows.begin() + static_cast<std::ptrdiff_t>(i * nDims));
+		}
+	}
+};
+
+// Brute force that stops summing up a distance as soon as it is beyond the current kMax-th neighbor, with the
+// dims ordered by variance so big terms come first. Candidates are visited outwards from the query along the
+// first dim: close objects tighten the limit fast and a side is done as soon as its first term alone exceeds it.
+// Partial sums (variance order) and real distances (subspace order) are rounded differently, so a candidate is
+// only abandoned if its partial sum exceeds the limit by more than the possible rounding error. The remaining
+// candidates get their distance recalculated in subspace order.
+class TBBHelperAbandon {
+	public:
+		// number of summed up terms, to compare the effort with the tiled kernel
+		std::size_t terms;
+
+		TBBHelperAbandon(distCache_t& _result, std::size_t _kMax, const Projection& _points, const SweepIndex& _index, std::atomic<std::size_t>& _progress) :
+			terms(0),
+			result(_result),
+			kMax(_kMax),
+			points(_points),
+			index(_index),
+			progress(_progress) {}
+
+		TBBHelperAbandon(TBBHelperAbandon& obj, tbb::split) :
+			terms(0),
+			result(obj.result),
+			kMax(obj.kMax),
+			points(obj.points),
+			index(obj.index),
+			progress(obj.progress) {}
+
+		void operator()(const tbb::blocked_range<std::size_t>& range) {
+			std::size_t nObjs = points.getSize();
+			std::size_t nDims = points.getDims();
+			assert((kMax > 0) && (kMax < nObjs));
+
+			// relative error of both sums is below (nDims + 1) * epsilon / 2
+			data_t margin = 1 + 2 * static_cast<data_t>(nDims + 1) * std::numeric_limits<data_t>::epsilon();
+			KnnHeap::neighbors_t neighbors;
+
+			for (std::size_t obj1 = range.begin(); obj1 != range.end(); ++obj1) {
+				std::size_t pos = index.positions[obj1];
+				const data_t* query = index.rows.data() + pos * nDims;
+				KnnHeap heap(kMax, neighbors);
+
+				// next candidate on both sides, side is done if it reaches the end
+				std::size_t below = pos;
+				std::size_t above = pos + 1;
+				bool belowOpen = (below > 0);
+				bool aboveOpen = (above < nObjs);
+
+				while (belowOpen || aboveOpen) {
+					// the side with the smaller first term
+					bool takeAbove = aboveOpen && (!belowOpen || (index.rows[above * nDims] - query[0] <= query[0] - index.rows[(below - 1) * nDims]));
+					std::size_t candidatePos = takeAbove ? above++ : --below;
+
+					const data_t* candidate = index.rows.data() + candidatePos * nDims;
+					data_t bound = heap.getLimit() * margin;
+					data_t delta = query[0] - candidate[0];
+					data_t sum = delta * delta;
+					++terms;
+					if (sum > bound) {
+						// all further objects of this side are even farther away in the first dim
+						if (takeAbove) {
+							aboveOpen = false;
+						} else {
+							belowOpen = false;
+						}
+						continue;
+					}
+
+					for (std::size_t s = 1; (s < nDims) && (sum <= bound); ++s) {
+						delta = query[s] - candidate[s];
+						sum += delta * delta;
+						++terms;
+					}
+					if (sum <= bound) {
+						std::size_t obj2 = index.ids[candidatePos];
+						heap.add(obj2, points.dist2(points.get(obj1), points.get(obj2)));
+					}
+
+					belowOpen = belowOpen && (below > 0);
+					aboveOpen = aboveOpen && (above < nObjs);
+				}
+				heap.finish();
+
+				storeNeighbors(neighbors.begin(), neighbors.end(), result[obj1]);
+
+				reportProgress(progress);
+			}
+		}
+
+		void join(TBBHelperAbandon& obj) {
+			this->terms += obj.terms;
+		}
+
+	private:
+		distCache_t& result;
+		std::size_t kMax;
+		const Projection& points;
+		const SweepIndex& index;
+		std::atomic<std::size_t>& progress;
+};
+
+class TBBHelperTree {
+	public:
+		TBBHelperTree(distCache_t& _result, std::size_t _kMax, const KDTree& _tree, std::atomic<std::size_t>& _progress) :
+			result(_result),
+			kMax(_kMax),
+			tree(_tree),
+			progress(_progress) {}
+
+		TBBHelperTree(TBBHelperTree& obj, tbb::split) :
+			result(obj.result),
+			kMax(obj.kMax),
+			tree(obj.tree),
+			progress(obj.progress) {}
+
+		void operator()(const tbb::blocked_range<std::size_t>& range) {
+			KnnHeap::neighbors_t neighbors;
+
+			for (std::size_t obj = range.begin(); obj != range.end(); ++obj) {
+				tree.query(obj, kMax, neighbors);
+				storeNeighbors(neighbors.begin(), neighbors.end(), result[obj]);
+
+				reportProgress(progress);
+			}
+		}
+
+		void join(TBBHelperTree&) {}
+
+	private:
+		distCache_t& result;
+		std::size_t kMax;
+		const KDTree& tree;
+		std::atomic<std::size_t>& progress;
+};
+
+// a KD-tree only helps if there are much more objects than cells of a (2 x ... x 2) grid
+bool treePaysOff(std::size_t nObjs, std::size_t nDims, std::size_t maxTreeDims) {
+	return (nDims <= maxTreeDims) && (nDims < 32) && ((treeLeafSize << nDims) <= nObjs);
+}
+
+distCache_t precalcDists(std::size_t kMax, const std::vector<datadim_t>& data, const subspace_t& subspace, std::size_t maxTreeDims) {
+	std::size_t nObjs = data[0]->getSize();
+	distCache_t result(nObjs);
+	std::atomic<std::size_t> progress(0);
+	Projection points(data, subspace);
+
+	if (treePaysOff(nObjs, subspace.size(), maxTreeDims)) {
+		KDTree tree(points, treeLeafSize);
+
+		TBBHelperTree helper(result, kMax, tree, progress);
+		parallel_reduce(tbb::blocked_range<std::size_t>(0, nObjs), helper);
+	} else {
+		SweepIndex index(points);
+		std::size_t nSample = std::min(sweepSample, nObjs);
+
+		TBBHelperAbandon sample(result, kMax, points, index, progress);
+		parallel_reduce(tbb::blocked_range<std::size_t>(0, nSample), sample);
+
+		if (sample.terms * sweepMinSaving <= nSample * (nObjs - 1) * subspace.size()) {
+			TBBHelperAbandon helper(result, kMax, points, index, progress);
+			parallel_reduce(tbb::blocked_range<std::size_t>(nSample, nObjs), helper);
+		} else {
+			TBBHelperBrute helper(result, kMax, points, progress);
+			parallel_reduce(tbb::blocked_range<std::size_t>(nSample, nObjs), helper);
+		}
+	}
+
+	return result;
+}
+
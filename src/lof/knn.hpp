@@ -0,0 +1,18 @@
+#ifndef KNN_HPP
+#define KNN_HPP
+
+#include <tuple>
+#include <vector>
+
+#include "sys.hpp"
+
+// (id, distance) of the nearest neighbors of every object, sorted by distance (ties by id)
+typedef std::vector<std::vector<std::tuple<std::size_t, data_t>>> distCache_t;
+
+// Exact kMax nearest neighbors of every object in subspace, including all ties of the kMax-th one. Subspaces with
+// up to maxTreeDims dimensions use a KD-tree if there are enough objects for it to pay off, all others are
+// searched with brute force (with early abandoning if a sample of queries shows that it saves enough work).
+distCache_t precalcDists(std::size_t kMax, const std::vector<datadim_t>& data, const subspace_t& subspace, std::size_t maxTreeDims);
+
+#endif
+
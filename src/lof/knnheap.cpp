@@ -0,0 +1,55 @@
+#include <algorithm>
+#include <limits>
+
+#include "knnheap.hpp"
+#include "projection.hpp"
+
+KnnHeap::KnnHeap(std::size_t _kMax, neighbors_t& _result) :
+	kMax(_kMax),
+	heap(),
+	limit(std::numeric_limits<data_t>::max()),
+	result(_result) {
+	heap.reserve(kMax);
+	result.clear();
+}
+
+void KnnHeap::add(std::size_t id, data_t dist2) {
+	if (dist2 > limit) {
+		return;
+	}
+
+	result.push_back(std::make_tuple(id, dist2));
+
+	// the limit can only shrink if one of the kMax best distances changes
+	if (heap.size() < kMax) {
+		heap.push_back(dist2);
+		std::push_heap(heap.begin(), heap.end());
+	} else if (dist2 < heap.front()) {
+		std::pop_heap(heap.begin(), heap.end());
+		heap.back() = dist2;
+		std::push_heap(heap.begin(), heap.end());
+	} else {
+		return;
+	}
+
+	if (heap.size() == kMax) {
+		data_t newLimit = tieLimit(heap.front());
+		if (newLimit < limit) {
+			limit = newLimit;
+
+			// drop candidates that cannot be part of the result anymore
+			if (result.size() > 4 * kMax) {
+				finish();
+			}
+		}
+	}
+}
+
+void KnnHeap::finish() {
+	data_t l = limit;
+	auto end = std::remove_if(result.begin(), result.end(), [l](const std::tuple<std::size_t, data_t>& x){
+			return std::get<1>(x) > l;
+		});
+	result.erase(end, result.end());
+}
+
@@ -0,0 +1,36 @@
+#ifndef KNNHEAP_HPP
+#define KNNHEAP_HPP
+
+#include <tuple>
+#include <vector>
+
+#include "sys.hpp"
+
+// Collects the kMax nearest neighbors of one query and all ties of the kMax-th one, as (id, squared distance).
+// The kMax best distances are kept in a max heap; as soon as it is full, getLimit() is the biggest squared
+// distance that can still be part of the result, so searches can skip everything beyond it.
+class KnnHeap {
+	public:
+		typedef std::vector<std::tuple<std::size_t, data_t>> neighbors_t;
+
+		// result gets cleared and filled with the candidates
+		KnnHeap(std::size_t kMax, neighbors_t& result);
+
+		data_t getLimit() const {
+			return limit;
+		}
+
+		void add(std::size_t id, data_t dist2);
+
+		// drops all candidates beyond the final limit, result is in no particular order
+		void finish();
+
+	private:
+		std::size_t kMax;
+		std::vector<data_t> heap;
+		data_t limit;
+		neighbors_t& result;
+};
+
+#endif
+
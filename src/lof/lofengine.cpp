@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_reduce.h>
+
+#include "lofengine.hpp"
+
+class TBBHelperLOF {
+	public:
+		typedef void (LOFEngine::*phase_t)(std::size_t obj);
+
+		TBBHelperLOF(LOFEngine& _engine, phase_t _phase) :
+			engine(_engine),
+			phase(_phase) {}
+
+		TBBHelperLOF(TBBHelperLOF& obj, tbb::split) :
+			engine(obj.engine),
+			phase(obj.phase) {}
+
+		void operator()(const tbb::blocked_range<std::size_t>& range) {
+			for (auto obj = range.begin(); obj != range.end(); ++obj) {
+				(engine.*phase)(obj);
+			}
+		}
+
+		void join(TBBHelperLOF&) {}
+
+	private:
+		LOFEngine& engine;
+		phase_t phase;
+};
+
+LOFEngine::LOFEngine(std::size_t _kMin, std::size_t kMax, const distCache_t& _distCache) :
+	kMin(_kMin),
+	nK(kMax - _kMin + 1),
+	distCache(_distCache),
+	kDists(_distCache.size() * nK),
+	neighborsEnds(_distCache.size() * nK),
+	lrds(_distCache.size() * nK),
+	maxLOFs(_distCache.size()) {
+	assert((kMin > 0) && (kMin <= kMax));
+}
+
+std::vector<data_t> LOFEngine::calcMaxLOFs() {
+	tbb::blocked_range<std::size_t> range(0, distCache.size());
+
+	TBBHelperLOF helperKDists(*this, &LOFEngine::calcKDists);
+	parallel_reduce(range, helperKDists);
+
+	TBBHelperLOF helperLRDs(*this, &LOFEngine::calcLRDs);
+	parallel_reduce(range, helperLRDs);
+
+	TBBHelperLOF helperLOFs(*this, &LOFEngine::calcMaxLOF);
+	parallel_reduce(range, helperLOFs);
+
+	return maxLOFs;
+}
+
+void LOFEngine::calcKDists(std::size_t obj) {
+	const auto& neighbors = distCache[obj];
+	data_t* kDist = kDists.data() + obj * nK;
+	std::size_t* neighborsEnd = neighborsEnds.data() + obj * nK;
+
+	// k-neighborhoods only grow with k
+	std::size_t end = 0;
+	for (std::size_t i = 0; i < nK; ++i) {
+		kDist[i] = std::get<1>(neighbors[kMin + i - 1]);
+		while ((end < neighbors.size()) && (std::get<1>(neighbors[end]) <= kDist[i])) {
+			++end;
+		}
+		neighborsEnd[i] = end;
+	}
+}
+
+void LOFEngine::calcLRDs(std::size_t obj) {
+	const auto& neighbors = distCache[obj];
+	const std::size_t* neighborsEnd = neighborsEnds.data() + obj * nK;
+	data_t* lrd = lrds.data() + obj * nK;
+
+	// neighbor i is part of the neighborhoods of all k from first on
+	std::fill(lrd, lrd + nK, 0.0);
+	std::size_t first = 0;
+	for (std::size_t i = 0; i < neighborsEnd[nK - 1]; ++i) {
+		while (neighborsEnd[first] <= i) {
+			++first;
+		}
+
+		std::size_t neighbor = std::get<0>(neighbors[i]);
+		data_t dist = std::get<1>(neighbors[i]);
+		const data_t* neighborKDist = kDists.data() + neighbor * nK;
+		for (std::size_t j = first; j < nK; ++j) {
+			lrd[j] += std::max(neighborKDist[j], dist);
+		}
+	}
+
+	// duplicates have a reachability sum of 0, their infinite LRD stays 0 (so it can be summed up) because -ffast-math
+	// builds can't test for infinity; the k-distance only grows with k, so these are always the smallest k
+	for (std::size_t i = 0; i < nK; ++i) {
+		if (lrd[i] > 0.0) {
+			lrd[i] = static_cast<data_t>(neighborsEnd[i]) / lrd[i];
+		}
+	}
+}
+
+void LOFEngine::calcMaxLOF(std::size_t obj) {
+	const auto& neighbors = distCache[obj];
+	const std::size_t* neighborsEnd = neighborsEnds.data() + obj * nK;
+	const data_t* lrd = lrds.data() + obj * nK;
+
+	std::vector<data_t> sums(nK, 0.0);
+	std::vector<char> infinites(nK, false);
+	std::size_t first = 0;
+	for (std::size_t i = 0; i < neighborsEnd[nK - 1]; ++i) {
+		while (neighborsEnd[first] <= i) {
+			++first;
+		}
+
+		const data_t* neighborLRD = lrds.data() + std::get<0>(neighbors[i]) * nK;
+		for (std::size_t j = first; j < nK; ++j) {
+			sums[j] += neighborLRD[j];
+		}
+		for (std::size_t j = first; (j < nK) && (neighborLRD[j] == 0.0); ++j) {
+			infinites[j] = true;
+		}
+	}
+
+	// infinite LRDs are resolved explicitly: a duplicate among duplicates has an undefined LOF (inf / inf) for that k,
+	// which makes the maximum undefined as well
+	data_t best = 0.0;
+	for (std::size_t i = 0; i < nK; ++i) {
+		if (lrd[i] == 0.0) {
+			if (infinites[i]) {
+				best = std::numeric_limits<data_t>::quiet_NaN();
+				break;
+			}
+		} else if (infinites[i]) {
+			best = std::numeric_limits<data_t>::infinity();
+		} else {
+			best = std::max(best, sums[i] / (lrd[i] * static_cast<data_t>(neighborsEnd[i])));
+		}
+	}
+	maxLOFs[obj] = best;
+}
+
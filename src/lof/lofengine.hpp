@@ -0,0 +1,37 @@
+#ifndef LOFENGINE_HPP
+#define LOFENGINE_HPP
+
+#include <vector>
+
+#include "knn.hpp"
+#include "sys.hpp"
+
+// LOF values for all k in [kMin, kMax] from one neighbor cache (needs at least kMax neighbors per object). Each
+// phase (k-distances, LRDs, LOFs) is one parallel pass over the objects that handles all k at once: the neighbors
+// of k are a prefix of the neighbors of k + 1, so every neighbor list is only walked once per phase.
+class LOFEngine {
+	public:
+		LOFEngine(std::size_t kMin, std::size_t kMax, const distCache_t& distCache);
+
+		// maximum LOF over all k for every object
+		std::vector<data_t> calcMaxLOFs();
+
+	private:
+		std::size_t kMin;
+		std::size_t nK;
+		const distCache_t& distCache;
+
+		// per object and k (row = object): k-distance, end of the k-neighborhood (ties included), LRD (0 = infinite)
+		std::vector<data_t> kDists;
+		std::vector<std::size_t> neighborsEnds;
+		std::vector<data_t> lrds;
+		std::vector<data_t> maxLOFs;
+
+		// phases for one object
+		void calcKDists(std::size_t obj);
+		void calcLRDs(std::size_t obj);
+		void calcMaxLOF(std::size_t obj);
+};
+
+#endif
+
@@ -1,5 +1,4 @@
 #include <algorithm>
-#include <atomic>
 #include <cassert>
 #include <iostream>
 #include <limits>
@@ -12,12 +11,12 @@
 
 #include <boost/program_options.hpp>
 
-#include <tbb/blocked_range.h>
-#include <tbb/parallel_reduce.h>
 #include <tbb/task_scheduler_init.h>
 
 #include "sys.hpp"
 #include "tracer.hpp"
+#include "knn.hpp"
+#include "lofengine.hpp"
 
 #include "greycore/database.hpp"
 #include "greycore/dim.hpp"
@@ -26,13 +25,9 @@
 namespace gc = greycore;
 namespace po = boost::program_options;
 
-typedef std::vector<std::vector<std::tuple<std::size_t, data_t>>> distCache_t;
-typedef std::vector<std::tuple<data_t, std::size_t>> kDists_t;
-typedef std::vector<datadimObj_t::segment_t*> segmentPtrs_t;
-
-std::vector<std::size_t> parseSS(const std::string& s) {
+subspace_t parseSS(const std::string& s) {
 	std::stringstream stream(s);
-	std::vector<std::size_t> result;
+	subspace_t result;
 
 	std::string id;
 	while (std::getline(stream, id, ',')) {
@@ -44,186 +39,6 @@ std::vector<std::size_t> parseSS(const std::string& s) {
 	return result;
 }
 
-data_t d(std::size_t i, std::size_t j, const segmentPtrs_t& ptrs1, const segmentPtrs_t& ptrs2) {
-	data_t sum = 0;
-
-	for (std::size_t s = 0; s < ptrs1.size(); ++s) {
-		data_t posA = (*(ptrs1[s]))[i];
-		data_t posB = (*(ptrs2[s]))[j];
-		data_t delta = posA - posB;
-		sum += delta * delta;
-	}
-
-	return sqrt(sum);
-}
-
-class TBBHelper {
-	public:
-		TBBHelper(distCache_t& _result, std::size_t _kMax, const std::vector<datadim_t>& _data, const std::vector<std::size_t>& _subspace, std::atomic<std::size_t>& _progress, std::size_t _obj1base, segmentPtrs_t& _segmentPtr1) :
-			result(_result),
-			kMax(_kMax),
-			data(_data),
-			subspace(_subspace),
-			progress(_progress),
-			obj1base(_obj1base),
-			segmentPtr1(_segmentPtr1) {}
-
-		TBBHelper(TBBHelper& obj, tbb::split) :
-			result(obj.result),
-			kMax(obj.kMax),
-			data(obj.data),
-			subspace(obj.subspace),
-			progress(obj.progress),
-			obj1base(obj.obj1base),
-			segmentPtr1(obj.segmentPtr1) {}
-
-		void operator()(const tbb::blocked_range<std::size_t>& range) {
-			std::size_t nObjs = data[0]->getSize();
-			std::vector<std::tuple<std::size_t, data_t>> dists(nObjs - 1);
-			std::size_t nSegments = data[0]->getSegmentCount();
-
-			// level 1: objects
-			for (std::size_t i = range.begin(); i != range.end(); ++i) {
-				std::size_t obj1 = obj1base + i;
-
-				// level 2: segments
-				std::size_t obj2 = 0;
-				std::size_t idx = 0;
-				for (std::size_t segment2 = 0; segment2 < nSegments; ++segment2) {
-					std::size_t size2 = data[0]->getSegmentFillSize(segment2);
-
-					segmentPtrs_t segmentPtr2(subspace.size());
-					std::size_t ptrIter2 = 0;
-					for (std::size_t s : subspace) {
-						const auto& dim = data[s];
-						segmentPtr2[ptrIter2++] = dim->getSegment(segment2);
-					}
-
-					// level 2: objects
-					for (std::size_t j = 0; j < size2; ++j) {
-						if (obj1 != obj2) {
-							dists[idx++] = std::make_tuple(obj2, d(i, j, segmentPtr1, segmentPtr2));
-						}
-
-						++obj2;
-					}
-				}
-
-				std::sort(dists.begin(), dists.end(), [](const std::tuple<std::size_t, data_t>& a, const std::tuple<std::size_t, data_t>& b){
-					return std::get<1>(a) < std::get<1>(b);
-				});
-
-				auto& neighbors = result[obj1];
-				data_t kMaxDist = std::get<1>(dists[kMax - 1]);
-				auto neighbor = dists.begin();
-				for (; (neighbor != dists.end()) && (std::get<1>(*neighbor) <= kMaxDist); ++neighbor) {}
-				neighbors.assign(dists.begin(), neighbor);
-
-				// report progress
-				std::size_t p = progress++;
-				if (p % 1000 == 0) {
-					std::cout << "+" << std::flush;
-				}
-			}
-		}
-
-		void join(TBBHelper&) {}
-
-	private:
-		distCache_t& result;
-		std::size_t kMax;
-		const std::vector<datadim_t>& data;
-		const std::vector<std::size_t>& subspace;
-		std::atomic<std::size_t>& progress;
-		std::size_t obj1base;
-		segmentPtrs_t& segmentPtr1;
-};
-
-distCache_t precalcDists(std::size_t kMax, const std::vector<datadim_t>& data, const std::vector<std::size_t>& subspace) {
-	std::size_t nObjs = data[0]->getSize();
-	std::size_t nSegments = data[0]->getSegmentCount();
-	distCache_t result(nObjs);
-	std::atomic<std::size_t> progress(0);
-
-	// level 1: segments
-	std::size_t obj1base = 0;
-	for (std::size_t segment1 = 0; segment1 < nSegments; ++segment1) {
-		std::size_t size1 = data[0]->getSegmentFillSize(segment1);
-
-		segmentPtrs_t segmentPtr1(subspace.size());
-		std::size_t ptrIter1 = 0;
-		for (std::size_t s : subspace) {
-			const auto& dim = data[s];
-			segmentPtr1[ptrIter1++] = dim->getSegment(segment1);
-		}
-
-		// level 1: objects
-		TBBHelper helper(result, kMax, data, subspace, progress, obj1base, segmentPtr1);
-		parallel_reduce(tbb::blocked_range<std::size_t>(0, size1), helper);
-
-		obj1base += size1;
-	}
-
-	return result;
-}
-
-kDists_t calcKDists(std::size_t k, const std::vector<datadim_t>& data,const distCache_t& distCache) {
-	std::size_t nObjs = data[0]->getSize();
-	std::vector<std::tuple<data_t, std::size_t>> result(nObjs);
-
-	for (std::size_t obj1 = 0; obj1 < nObjs; ++obj1) {
-		const auto& distCachePtr = distCache[obj1];
-		auto& kDist = std::get<0>(result[obj1]);
-		auto& kNeighborsEnd = std::get<1>(result[obj1]);
-
-		kDist = std::get<1>(distCachePtr[k - 1]);
-		for (kNeighborsEnd = 0; (kNeighborsEnd < distCachePtr.size()) && (std::get<1>(distCachePtr[kNeighborsEnd]) <= kDist); ++kNeighborsEnd) {}
-	}
-
-	return result;
-}
-
-std::vector<data_t> calcLRDs(const std::vector<datadim_t>& data, const distCache_t& distCache, const kDists_t& dists) {
-	std::size_t nObjs = data[0]->getSize();
-	std::vector<data_t> result(nObjs);
-
-	for (std::size_t obj = 0; obj < nObjs; ++obj) {
-		const auto& distCachePtr = distCache[obj];
-		std::size_t neighborsEnd = std::get<1>(dists[obj]);
-
-		data_t sum = 0.0;
-		for (std::size_t i = 0; i < neighborsEnd; ++i) {
-			std::size_t neighbor = std::get<0>(distCachePtr[i]);
-			sum += std::max(std::get<0>(dists[neighbor]), std::get<1>(distCachePtr[i]));
-		}
-
-		result[obj] = static_cast<data_t>(neighborsEnd) / sum;
-	}
-
-	return result;
-}
-
-std::vector<data_t> calcLOF(std::size_t k, const std::vector<datadim_t>& data, const distCache_t& distCache) {
-	std::size_t nObjs = data[0]->getSize();
-	std::vector<data_t> result(nObjs);
-	auto dists = calcKDists(k, data, distCache);
-	auto lrds = calcLRDs(data, distCache, dists);
-
-	for (std::size_t obj = 0; obj < nObjs; ++obj) {
-		const auto& distCachePtr = distCache[obj];
-		std::size_t neighborsEnd = std::get<1>(dists[obj]);
-
-		data_t sum = 0.0;
-		for (std::size_t i = 0; i < neighborsEnd; ++i) {
-			std::size_t neighbor = std::get<0>(distCachePtr[i]);
-			sum += lrds[neighbor];
-		}
-		result[obj] = sum / (lrds[obj] * neighborsEnd);
-	}
-
-	return result;
-}
-
 int main(int argc, char **argv) {
 	// global config vars
 	std::string cfgSubspaces;
@@ -231,6 +46,7 @@ int main(int argc, char **argv) {
 	std::string cfgDbData;
 	std::size_t cfgMinPtsLower;
 	std::size_t cfgMinPtsUpper;
+	std::size_t cfgTreeDims;
 	std::size_t cfgThreads;
 
 	// parse program options
@@ -261,6 +77,11 @@ int main(int argc, char **argv) {
 			po::value(&cfgMinPtsUpper)->default_value(50),
 			"Upper bound for minPts"
 		)
+		(
+			"treeDims",
+			po::value(&cfgTreeDims)->default_value(10),
+			"Use a KD-tree for the neighbor search in subspaces with up to this many dimensions (0 = always brute force)"
+		)
 		(
 			"threads",
 			po::value(&cfgThreads)->default_value(0),
@@ -331,16 +152,11 @@ int main(int argc, char **argv) {
 			auto subspace = parseSS(ssstring);
 			if (subspace.size() > 0) {
 				std::cout << "Subspace " << sID << " (size=" << subspace.size() << "): " << std::flush;
-				auto cache = precalcDists(cfgMinPtsUpper, dims, subspace);
-
-				std::vector<data_t> bestLOFs(lofs.size(), -std::numeric_limits<data_t>::infinity());
-				for (std::size_t k = cfgMinPtsLower; k <= cfgMinPtsUpper; ++k) {
-					auto next = calcLOF(k, dims, cache);
-					bestLOFs = std::max(bestLOFs, next);
+				auto cache = precalcDists(cfgMinPtsUpper, dims, subspace, cfgTreeDims);
 
-					// report progress
-					std::cout << "." << std::flush;
-				}
+				// maximum over all k in [minPtsLower, minPtsUpper]
+				LOFEngine engine(cfgMinPtsLower, cfgMinPtsUpper, cache);
+				auto bestLOFs = engine.calcMaxLOFs();
 
 				for (std::size_t i = 0; i < bestLOFs.size(); ++i) {
 					lofs[i].push_back(bestLOFs[i]);
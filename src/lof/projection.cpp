@@ -0,0 +1,111 @@
+#include <algorithm>
+
+#include "projection.hpp"
+
+// Every lane sums up the dimensions of one object in subspace order, so the results are bit-identical to dist2.
+inline void dist2TileImpl(const data_t* query, const data_t* columns, std::size_t stride, std::size_t nDims, std::size_t n, data_t* out) {
+	std::fill(out, out + n, 0);
+
+	for (std::size_t s = 0; s < nDims; ++s) {
+		data_t q = query[s];
+		const data_t* column = columns + s * stride;
+
+		for (std::size_t j = 0; j < n; ++j) {
+			data_t delta = q - column[j];
+			out[j] += delta * delta;
+		}
+	}
+}
+
+void dist2TileGeneric(const data_t* query, const data_t* columns, std::size_t stride, std::size_t nDims, std::size_t n, data_t* out) {
+	dist2TileImpl(query, columns, stride, nDims, n, out);
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+// 4 instead of 2 doubles per instruction, no FMA (would change the rounding)
+__attribute__((target("avx2")))
+void dist2TileAVX2(const data_t* query, const data_t* columns, std::size_t stride, std::size_t nDims, std::size_t n, data_t* out) {
+	dist2TileImpl(query, columns, stride, nDims, n, out);
+}
+
+Projection::kernel_t selectTileKernel() {
+	return __builtin_cpu_supports("avx2") ? dist2TileAVX2 : dist2TileGeneric;
+}
+#else
+Projection::kernel_t selectTileKernel() {
+	return dist2TileGeneric;
+}
+#endif
+
+Projection::Projection(const std::vector<datadim_t>& data, const subspace_t& subspace) :
+	nObjs(data[0]->getSize()),
+	nDims(subspace.size()),
+	values(nObjs * nDims),
+	columns(nObjs * nDims),
+	kernel(selectTileKernel()) {
+	std::size_t nSegments = data[0]->getSegmentCount();
+
+	std::size_t base = 0;
+	for (std::size_t segment = 0; segment < nSegments; ++segment) {
+		std::size_t size = data[0]->getSegmentFillSize(segment);
+
+		std::size_t s = 0;
+		for (std::size_t dim : subspace) {
+			const auto& column = *(data[dim]->getSegment(segment));
+			data_t* targetRow = values.data() + base * nDims + s;
+			data_t* targetColumn = columns.data() + s * nObjs + base;
+
+			for (std::size_t i = 0; i < size; ++i) {
+				targetRow[i * nDims] = column[i];
+				targetColumn[i] = column[i];
+			}
+
+			++s;
+		}
+
+		base += size;
+	}
+}
+
+std::vector<std::size_t> Projection::getVarianceOrder() const {
+	std::vector<data_t> variances(nDims);
+	for (std::size_t s = 0; s < nDims; ++s) {
+		const data_t* column = columns.data() + s * nObjs;
+
+		data_t mean = 0;
+		for (std::size_t i = 0; i < nObjs; ++i) {
+			mean += column[i];
+		}
+		mean /= static_cast<data_t>(nObjs);
+
+		data_t sum = 0;
+		for (std::size_t i = 0; i < nObjs; ++i) {
+			data_t delta = column[i] - mean;
+			sum += delta * delta;
+		}
+		variances[s] = sum;
+	}
+
+	std::vector<std::size_t> order(nDims);
+	for (std::size_t s = 0; s < nDims; ++s) {
+		order[s] = s;
+	}
+	std::stable_sort(order.begin(), order.end(), [&variances](std::size_t a, std::size_t b){
+			return variances[a] > variances[b];
+		});
+
+	return order;
+}
+
+std::vector<data_t> Projection::getRows(const std::vector<std::size_t>& order) const {
+	std::vector<data_t> result(nObjs * order.size());
+
+	for (std::size_t i = 0; i < nObjs; ++i) {
+		for (std::size_t s = 0; s < order.size(); ++s) {
+			result[i * order.size() + s] = values[i * nDims + order[s]];
+		}
+	}
+
+	return result;
+}
+
@@ -0,0 +1,86 @@
+#ifndef PROJECTION_HPP
+#define PROJECTION_HPP
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "sys.hpp"
+
+// Values of all objects in one subspace, row-major (one row = the values of one object, in subspace order) for
+// single object access and column-major for the brute force kernel. This avoids the segment and column
+// indirections when the same subspace gets accessed over and over again.
+class Projection {
+	public:
+		// out[j] = squared distance of query to the objects 0..n-1 of columns (column stride = stride)
+		typedef void (*kernel_t)(const data_t* query, const data_t* columns, std::size_t stride, std::size_t nDims, std::size_t n, data_t* out);
+
+		Projection(const std::vector<datadim_t>& data, const subspace_t& subspace);
+
+		std::size_t getSize() const {
+			return nObjs;
+		}
+
+		std::size_t getDims() const {
+			return nDims;
+		}
+
+		const data_t* get(std::size_t obj) const {
+			return values.data() + obj * nDims;
+		}
+
+		// squared euclidean distance, summed up in subspace order
+		data_t dist2(const data_t* a, const data_t* b) const {
+			data_t sum = 0;
+
+			for (std::size_t s = 0; s < nDims; ++s) {
+				data_t delta = a[s] - b[s];
+				sum += delta * delta;
+			}
+
+			return sum;
+		}
+
+		// dims (positions in the subspace) sorted by variance, biggest first
+		std::vector<std::size_t> getVarianceOrder() const;
+
+		// row-major copy of all objects with the dims in the given order
+		std::vector<data_t> getRows(const std::vector<std::size_t>& order) const;
+
+		// out[j - begin] = dist2(query, get(j)) for j = begin..end-1, vectorized over the objects
+		void dist2Tile(const data_t* query, std::size_t begin, std::size_t end, data_t* out) const {
+			kernel(query, columns.data() + begin, nObjs, nDims, end - begin, out);
+		}
+
+	private:
+		std::size_t nObjs;
+		std::size_t nDims;
+		std::vector<data_t> values;
+		std::vector<data_t> columns;
+		kernel_t kernel;
+};
+
+// Biggest squared distance with the same root as dist2. Selecting neighbors by "squared distance <= tieLimit"
+// keeps exactly the ties that a selection by the (rounded) distance would keep.
+inline data_t tieLimit(data_t dist2) {
+	// zero: with -ffast-math (denormals are zero) the search below would step through all denormals
+	if (dist2 < std::numeric_limits<data_t>::min()) {
+		return dist2;
+	}
+
+	data_t root = std::sqrt(dist2);
+	data_t limit = dist2;
+
+	while (limit < std::numeric_limits<data_t>::max()) {
+		data_t next = std::nextafter(limit, std::numeric_limits<data_t>::max());
+		if (std::sqrt(next) > root) {
+			break;
+		}
+		limit = next;
+	}
+
+	return limit;
+}
+
+#endif
+